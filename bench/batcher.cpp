@@ -0,0 +1,207 @@
+// Headless RenderBatcher benchmark, built on the sokol dummy backend so batching
+// changes can be measured without a GPU. Only the CPU side of a frame is timed:
+// recording the draws, merging or sorting them and issuing the commands.
+// Built with `TRACK_ALLOCATIONS`, heap allocations in the timed frames are
+// reported as well.
+
+#include "alloc.hpp"
+#include "gfx/Drawable.hpp"
+#include "gfx/RenderBatcher.hpp"
+#include "math/Vec3.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+using namespace vt;
+
+static constexpr i32 _TARGET_WIDTH = 1920;
+static constexpr i32 _TARGET_HEIGHT = 1080;
+static constexpr f32 _SPRITE_SIZE = 16.0;
+static constexpr u32 _TEXTURE_COUNT = 8;
+static constexpr u32 _DRAWS_PER_SCENARIO = 2000000; // Spread over several frames
+static constexpr u32 _MIN_FRAMES = 3;
+
+struct Scenario {
+	const char *name;
+	u32 sprites;
+	u32 textures;	   // Interleaved from one sprite to the next
+	f32 spread;		   // Part of the target the sprites are scattered over
+	u32 scissor_every; // Sprites between two scissor changes, zero for none
+};
+
+struct Mode {
+	const char *name;
+	BatcherSettings settings;
+};
+
+struct Result {
+	f64 ns_per_draw;
+	FrameStats stats; // Of the last frame
+	alloc::Counters allocs; // Over the timed frames
+};
+
+static const Scenario _SCENARIOS[] = {
+	{ "sprites 10k", 10000, 1, 1.0, 0 },
+	{ "sprites 100k", 100000, 1, 1.0, 0 },
+	{ "sprites 1M", 1000000, 1, 1.0, 0 },
+	{ "interleaved textures", 100000, _TEXTURE_COUNT, 1.0, 0 },
+	{ "heavy overlap", 100000, 4, 0.05, 0 },
+	{ "scissor changes", 100000, 1, 1.0, 16 },
+};
+
+static const Mode _MODES[] = {
+	{ "immediate", {} },
+	{ "indexed", { .indexed = true } },
+	{ "indirect", { .indexed = true, .indirect_merge = true } },
+	{ "deferred", { .indexed = true, .deferred = true } },
+};
+
+static Result _run(
+	const Mode& mode,
+	const Scenario& scenario,
+	const sg_attachments& target,
+	std::span<const Vec3> positions,
+	std::span<Drawable> sprites
+) {
+	RenderBatcher batcher;
+	if (!batcher.init(mode.settings)) {
+		std::fprintf(stderr, "Failed to initialize the batcher\n");
+		std::exit(EXIT_FAILURE);
+	}
+
+	u32 frames = std::max(_DRAWS_PER_SCENARIO / scenario.sprites, _MIN_FRAMES);
+	auto draw_frame = [&]() {
+		batcher.set_target(target);
+		for (u32 i = 0; i < scenario.sprites; i += 1) {
+			if (scenario.scissor_every > 0 && i % scenario.scissor_every == 0) {
+				f32 inset = (i / scenario.scissor_every) % 2 == 0 ? 0.0 : 8.0;
+				batcher.apply_scissor(
+					inset, inset, _TARGET_WIDTH - inset * 2, _TARGET_HEIGHT - inset * 2
+				);
+			}
+
+			Drawable& sprite = sprites[i % scenario.textures];
+			sprite.set_position(positions[i]);
+			batcher.draw(sprite);
+		}
+
+		batcher.flush();
+		sg_commit();
+	};
+
+	draw_frame(); // Warm up the arenas and pipelines
+
+	alloc::begin_frame();
+	auto start = std::chrono::steady_clock::now();
+	for (u32 frame = 0; frame < frames; frame += 1) {
+		draw_frame();
+	}
+	auto elapsed = std::chrono::steady_clock::now() - start;
+	alloc::Counters allocs = alloc::end_frame();
+
+	Result result {
+		.ns_per_draw = std::chrono::duration<f64, std::nano>(elapsed).count()
+					 / ((f64)scenario.sprites * frames),
+		.stats = batcher.get_stats(),
+		.allocs = allocs,
+	};
+
+	batcher.terminate();
+	return result;
+}
+
+int main() {
+	sg_desc desc {};
+	desc.environment.defaults = {
+		.color_format = SG_PIXELFORMAT_RGBA8,
+		.depth_format = SG_PIXELFORMAT_DEPTH,
+		.sample_count = 1,
+	};
+	sg_setup(desc);
+
+	sg_image_desc color_desc {};
+	color_desc.usage.render_attachment = true;
+	color_desc.width = _TARGET_WIDTH;
+	color_desc.height = _TARGET_HEIGHT;
+	color_desc.pixel_format = SG_PIXELFORMAT_RGBA8;
+
+	sg_image_desc depth_desc = color_desc;
+	depth_desc.pixel_format = SG_PIXELFORMAT_DEPTH;
+
+	sg_attachments_desc target_desc {};
+	target_desc.colors[0].image = sg_make_image(&color_desc);
+	target_desc.depth_stencil.image = sg_make_image(&depth_desc);
+	sg_attachments target = sg_make_attachments(&target_desc);
+
+	std::vector<Texture> textures = { make_common_texture() };
+	for (u32 i = 1; i < _TEXTURE_COUNT; i += 1) {
+		u32 pixels[16] = {};
+		sg_image_desc image_desc {};
+		image_desc.width = 4;
+		image_desc.height = 4;
+		image_desc.usage.immutable = true;
+		image_desc.data.subimage[0][0] = SG_RANGE(pixels);
+		textures.push_back(Texture { sg_make_image(&image_desc), textures[0].smp });
+	}
+
+	// Sprites are moved before each draw, like a game would
+	std::vector<Drawable> sprites;
+	for (const auto& texture : textures) {
+		Drawable& sprite = sprites.emplace_back(
+			Drawable::make_rect(DrawMode::ModeFill, 0.0, 0.0, _SPRITE_SIZE, _SPRITE_SIZE)
+		);
+		sprite.set_texture(0, texture);
+	}
+
+	std::printf(
+		"%-22s %-10s %9s %11s %11s %14s\n", "scenario", "mode", "ns/draw", "draw calls",
+		"merge ratio", "bytes uploaded"
+	);
+
+	std::mt19937 rng(42);
+	for (const auto& scenario : _SCENARIOS) {
+		f32 width = (_TARGET_WIDTH - _SPRITE_SIZE) * scenario.spread;
+		f32 height = (_TARGET_HEIGHT - _SPRITE_SIZE) * scenario.spread;
+		std::uniform_real_distribution<f32> x(0.0, width);
+		std::uniform_real_distribution<f32> y(0.0, height);
+
+		std::vector<Vec3> positions(scenario.sprites);
+		for (auto& position : positions) {
+			position = Vec3(x(rng), y(rng), 0.0);
+		}
+
+		for (const auto& mode : _MODES) {
+			Result result = _run(mode, scenario, target, positions, sprites);
+
+			// Sprites per draw call issued
+			f64 merge_ratio = (f64)scenario.sprites
+							/ std::max(result.stats.draw_calls, 1u);
+			std::printf(
+				"%-22s %-10s %9.1f %11u %11.1f %14llu\n", scenario.name, mode.name,
+				result.ns_per_draw, result.stats.draw_calls, merge_ratio,
+				(unsigned long long)result.stats.bytes_uploaded
+			);
+
+			if (result.allocs.allocations > 0) {
+				std::fprintf(
+					stderr, "%s / %s: %llu heap allocations in timed frames\n",
+					scenario.name, mode.name,
+					(unsigned long long)result.allocs.allocations
+				);
+			}
+		}
+	}
+
+	for (u32 i = 1; i < _TEXTURE_COUNT; i += 1) {
+		sg_destroy_image(textures[i].img);
+	}
+	sg_destroy_attachments(target);
+	sg_destroy_image(target_desc.colors[0].image);
+	sg_destroy_image(target_desc.depth_stencil.image);
+	sg_shutdown();
+
+	return EXIT_SUCCESS;
+}
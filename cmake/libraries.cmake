@@ -5,22 +5,23 @@ set(FETCHCONTENT_QUIET FALSE)
 
 set(_LIBS_DIR ${CMAKE_SOURCE_DIR}/ext)
 
-function(setup_libraries target)
-	# Find and link libraries
-	find_package(LuaJIT REQUIRED)
+# Find and fetch libraries, once for every target linking them
+find_package(LuaJIT REQUIRED)
 
-	FetchContent_Declare(
-		SDL3
-		GIT_REPOSITORY "git@github.com:libsdl-org/SDL.git"
-		GIT_TAG "release-3.2.14"
-		GIT_PROGRESS TRUE
+FetchContent_Declare(
+	SDL3
+	GIT_REPOSITORY "git@github.com:libsdl-org/SDL.git"
+	GIT_TAG "release-3.2.14"
+	GIT_PROGRESS TRUE
 
-		FIND_PACKAGE_ARGS "3.2.14"
-	)
-	FetchContent_MakeAvailable(SDL3)
+	FIND_PACKAGE_ARGS "3.2.14"
+)
+FetchContent_MakeAvailable(SDL3)
 
-	add_subdirectory("${_LIBS_DIR}/sol2")
+add_subdirectory("${_LIBS_DIR}/sol2")
 
+# Libraries the engine core needs, the benchmarks link only these
+function(setup_core_libraries target)
 	target_include_directories(
 		${target}
 		PRIVATE
@@ -32,11 +33,20 @@ function(setup_libraries target)
 		${target}
 		PRIVATE
 			SDL3::SDL3
-			luajit::luajit
-			sol2::sol2
 	)
 
 	if(UNIX)
 		target_link_libraries(${target} PRIVATE m ${CMAKE_DL_LIBS})
 	endif()
 endfunction()
+
+function(setup_libraries target)
+	setup_core_libraries(${target})
+
+	target_link_libraries(
+		${target}
+		PRIVATE
+			luajit::luajit
+			sol2::sol2
+	)
+endfunction()
@@ -2,10 +2,18 @@
 #define _VT_ENGINE_HPP
 
 #include "core/Window.hpp"
+#include "gfx/FrameCapture.hpp"
 #include "gfx/RenderBatcher.hpp"
+#include "gfx/RenderTarget.hpp"
+#include "gfx/ShaderWatcher.hpp"
 
 namespace vt {
 
+enum class RedrawMode {
+	Continuous, // Draws and presents every frame
+	OnDemand,	// Waits for events and only draws when something changed
+};
+
 class Engine final {
 public:
 	static bool init() noexcept;
@@ -19,12 +27,39 @@ public:
 	Engine& operator=(const Engine&) = delete;
 
 	void run();
+	// Draws a frame capture in a loop instead of running the game, logging the
+	// average time spent replaying it
+	void replay(const char *path);
+
+	// Offscreen targets for passes and effects, recycled between frames
+	RenderTargetPool& get_target_pool();
+
+	void set_redraw_mode(RedrawMode mode);
+	// Draws the next frame in on-demand mode, for changes events don't signal
+	void request_redraw();
 
 private:
+	static constexpr const char *_CAPTURE_PATH = "vitae.capture";
+	static constexpr u32 _REPLAY_REPORT_FRAMES = 256;
+	// Frames the arenas are given to grow before allocating is reported
+	static constexpr u64 _ALLOC_WARMUP_FRAMES = 8;
+	// Longest wait for events in on-demand mode before checking for changes
+	static constexpr i32 _IDLE_WAIT_MS = 100;
+
 	Window m_window;
 	RenderBatcher m_render;
+	RenderTargetPool m_targets;
+	ShaderWatcher m_shader_watcher;
+	FrameCapture m_capture;
+	RedrawMode m_redraw_mode { RedrawMode::Continuous };
+	bool m_redraw_requested { true };
+	bool m_should_quit {};
+	bool m_capturing {};
 	bool m_is_valid {};
 
+	bool _process_events(bool wait);
+	void _handle_event(const SDL_Event& event);
+
 	bool _init_graphics_driver();
 	void _terminate_graphics_driver();
 };
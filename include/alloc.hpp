@@ -0,0 +1,25 @@
+#ifndef _VT_ALLOC_HPP
+#define _VT_ALLOC_HPP
+
+#include "types.hpp"
+
+namespace vt::alloc {
+
+struct Counters {
+	u64 allocations;
+	u64 frees;
+	u64 bytes; // Requested by the allocations
+};
+
+// Heap allocations made through `operator new` by every thread since startup.
+// Only counted when built with `VT_TRACK_ALLOCATIONS`, zero otherwise.
+Counters get_counters();
+
+// Scopes the counters to a frame: `end_frame` returns what was allocated since
+// the matching `begin_frame`
+void begin_frame();
+Counters end_frame();
+
+} // namespace vt::alloc
+
+#endif
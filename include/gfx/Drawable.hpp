@@ -2,6 +2,7 @@
 #define _VT_GFX_DRAWABLE_HPP
 
 #include "gfx/common.hpp"
+#include "math/Mat4.hpp"
 #include "math/Rect.hpp"
 #include "math/Transform.hpp"
 
@@ -18,7 +19,11 @@ enum class DrawMode : u8 {
 class Drawable : public Transform {
 public:
 	Drawable() = default;
-	Drawable(sg_primitive_type primitive, const std::span<Vertex>& vertices = {});
+	Drawable(
+		sg_primitive_type primitive,
+		const std::span<Vertex>& vertices = {},
+		const std::span<const u16>& indices = {}
+	);
 
 	static Drawable make_rect(
 		DrawMode mode, f32 x, f32 y, f32 w, f32 h, const Color& color = Color::White
@@ -28,15 +33,38 @@ public:
 	);
 
 	void append_vertices(const std::span<Vertex>& vertices);
+	// Indices are relative to this drawable's own vertices
+	void append_indices(const std::span<const u16>& indices);
 
 	void set_texture(u32 slot, const Texture& texture);
 
 private:
 	sg_primitive_type m_primitive = SG_PRIMITIVETYPE_TRIANGLES;
 	std::vector<Vertex> m_vertices;
-	TexturesUniform m_textures;
+	std::vector<u16> m_indices;
+	TexturesUniform m_textures {};
+	// Local space area covered by the vertices, as corners
+	Rect m_bounds {};
+
+	// Whether the bounds transformed by `mvp` overlap `clip`, in clip space
+	bool _is_visible(const Mat4& mvp, const Rect& clip) const;
+	// Clip space depth of the bounds center
+	f32 _get_depth(const Mat4& mvp) const;
+
+	// Writes the vertices transformed by `mvp` and returns the area they cover,
+	// expanded drawables write one vertex per index
+	Rect _emit_vertices(const Mat4& mvp, bool expand, std::span<Vertex> out) const;
+	Rect _emit_vertices(
+		const Mat4& mvp, bool expand, std::span<CompactVertex> out
+	) const;
+	Rect _emit_vertices(
+		const Mat4& mvp, bool expand, std::span<MultiTextureVertex> out
+	) const;
+	void _emit_indices(u32 base_vertex, std::span<u16> out) const;
 
+	friend class BatchContext;
 	friend class RenderBatcher;
+	friend class StaticBatch;
 };
 
 } // namespace vt
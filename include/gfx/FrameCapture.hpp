@@ -0,0 +1,136 @@
+#ifndef _VT_GFX_FRAMECAPTURE_HPP
+#define _VT_GFX_FRAMECAPTURE_HPP
+
+#include "gfx/RenderBatcher.hpp"
+#include "gfx/common.hpp"
+
+#include <sokol/sokol_gfx.h>
+#include <vector>
+
+namespace vt {
+
+/**
+ * Commands of a single frame along with the arenas they read, recorded by
+ * `RenderBatcher::capture_frame` so the frame can be saved and replayed offline
+ * without the code that drew it.
+ *
+ * NOTE: Resources are recorded by handle and remade for the replay. Images are
+ * blank ones of the same size, custom pipelines fall back to the common one and
+ * retained geometry is left out since its vertices only live on the GPU.
+ */
+class FrameCapture {
+public:
+	FrameCapture() = default;
+
+	FrameCapture(const FrameCapture&) = delete;
+	FrameCapture& operator=(const FrameCapture&) = delete;
+
+	bool save(const char *path) const;
+	bool load(const char *path);
+	// Remakes the recorded resources and points the commands at them, required
+	// before replaying
+	bool make_resources();
+	void destroy_resources();
+	void clear();
+
+	// The recorded frame was committed
+	[[nodiscard]] bool is_complete() const;
+	// Settings of the recording batcher, a replaying one must be made with them
+	[[nodiscard]] const BatcherSettings& get_settings() const;
+
+private:
+	static constexpr u32 _MAGIC = 0x46435456; // "VTCF"
+	static constexpr u32 _VERSION = 1;
+
+	using BatchCommand = RenderBatcher::BatchCommand;
+	using TextureGroup = RenderBatcher::TextureGroup;
+
+	struct Header {
+		u32 magic;
+		u32 version;
+		u32 command_size; // Commands are stored as is, so only the same build reads them
+		BatcherSettings settings;
+	};
+
+	enum class PipelineKind : u8 {
+		Batch = 0, // Common or multi-texture pipeline
+		Instanced,
+		Custom,
+	};
+
+	struct CapturedPipeline {
+		u32 id;
+		PipelineKind kind;
+		DrawPass pass;
+		sg_primitive_type primitive;
+		sg_index_type index_type;
+	};
+
+	struct CapturedImage {
+		u32 id;
+		i32 width;
+		i32 height;
+		bool common; // Replayed with the common texture itself
+	};
+
+	struct CapturedSampler {
+		u32 id;
+		sg_sampler_desc desc; // Label dropped
+		bool common;
+	};
+
+	// Arenas of one submit, as ranges of the capture ones
+	struct CapturedBatch {
+		u32 command_idx;
+		u32 command_count;
+		u32 vertex_idx;
+		u32 vertex_count;
+		u32 index_idx;
+		u32 index_count;
+		u32 instance_idx;
+		u32 instance_count;
+		u32 uniform_idx;
+		u32 uniform_size;
+		u32 group_idx;
+		u32 group_count;
+	};
+
+	BatcherSettings m_settings {};
+	bool m_complete {};
+	bool m_has_resources {};
+
+	std::vector<CapturedBatch> m_batches;
+	std::vector<BatchCommand> m_commands;
+	std::vector<u8> m_vertices; // Stored in the vertex format of the settings
+	std::vector<u16> m_indices;
+	std::vector<SpriteInstance> m_instances;
+	std::vector<u8> m_uniforms;
+	std::vector<TextureGroup> m_texture_groups;
+
+	std::vector<CapturedPipeline> m_pipelines;
+	std::vector<CapturedImage> m_images;
+	std::vector<CapturedSampler> m_samplers;
+
+	// Replay resources, in the order of the tables above
+	std::vector<sg_image> m_replay_images;
+	std::vector<sg_sampler> m_replay_samplers;
+
+	void _record_batch(
+		const RenderBatcher& batcher,
+		u32 command_count,
+		u32 vertex_count,
+		u32 index_count,
+		u32 instance_count
+	);
+	// Every batch fits the capture arenas and every draw fits its batch
+	bool _check_ranges() const;
+	void _record_pipeline(sg_pipeline pipeline);
+	void _record_texture(const Texture& texture);
+	void _remap_texture(Texture& texture) const;
+
+	friend class RenderBatcher;
+};
+
+} // namespace vt
+
+#endif
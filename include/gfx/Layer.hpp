@@ -0,0 +1,69 @@
+#ifndef _VT_GFX_LAYER_HPP
+#define _VT_GFX_LAYER_HPP
+
+#include "gfx/Drawable.hpp"
+#include "gfx/RenderTarget.hpp"
+#include "math/Transform.hpp"
+#include "math/Vec2i.hpp"
+
+#include <vector>
+
+namespace vt {
+
+class RenderBatcher;
+
+/**
+ * Drawables rendered once into an offscreen target and then drawn as a single
+ * quad, until one of them changes. Suits content that changes a few times per
+ * second at most, like a HUD or a background.
+ *
+ * NOTE: Drawables are referenced and must outlive the layer or be removed from
+ * it. The layer's own transform only moves the quad, so scrolling it doesn't
+ * render it again.
+ */
+class Layer : public Transform {
+public:
+	Layer() = default;
+
+	Layer(const Layer&) = delete;
+	Layer& operator=(const Layer&) = delete;
+
+	void add(const Drawable& drawable);
+	void remove(const Drawable& drawable);
+	void clear();
+
+	// Size of the target in pixels, the drawables are laid out in it
+	void set_size(Point size);
+	// Renders the drawables again on the next update
+	void invalidate();
+
+	// Renders the drawables into the target if anything changed since the last
+	// time, returns whether it did. Pending draws of `batcher` are flushed to
+	// their own target first and the batcher is left targeting the layer, so
+	// layers are updated before setting the frame's target.
+	bool update(RenderBatcher& batcher, RenderTargetPool& pool);
+	// Draws the target as a single alpha blended quad with the layer's transform
+	void draw(RenderBatcher& batcher);
+	// Gives the target back to the pool, the next update renders a new one
+	void release(RenderTargetPool& pool);
+
+	[[nodiscard]] bool is_dirty() const;
+
+private:
+	struct LayerItem {
+		const Drawable *drawable;
+		u32 revision; // Of the drawable when last rendered
+	};
+
+	std::vector<LayerItem> m_items;
+	Point m_size {};
+	RenderTarget m_target;
+	Drawable m_quad;
+	bool m_dirty { true };
+
+	void _make_quad();
+};
+
+} // namespace vt
+
+#endif
@@ -0,0 +1,31 @@
+#ifndef _VT_GFX_PROGRAMCACHE_HPP
+#define _VT_GFX_PROGRAMCACHE_HPP
+
+#include "types.hpp"
+
+#include <sokol/sokol_gfx.h>
+#include <string>
+
+namespace vt::program_cache {
+
+struct Stats {
+	u32 hits;	  // Programs loaded from a cached binary
+	u32 misses;	  // Programs compiled from source, then cached
+	u32 rejected; // Cached binaries the driver refused, compiled from source
+};
+
+// Keeps linked GL programs in `dir`, which must exist, so later launches skip
+// compiling them. Shaders made before `init` are always compiled from source.
+// NOTE: Only the GL backend has program binaries, elsewhere it does nothing
+bool init(const std::string& dir);
+void terminate();
+
+// Counterparts of `sg_make_shader` and `sg_init_shader` going through the cache
+sg_shader make_shader(const sg_shader_desc& desc);
+void init_shader(sg_shader shdr, const sg_shader_desc& desc);
+
+[[nodiscard]] Stats get_stats();
+
+} // namespace vt::program_cache
+
+#endif
@@ -7,14 +7,19 @@
 #include "math/Rect.hpp"
 #include "math/Vec2i.hpp"
 
+#include <array>
 #include <sokol/sokol_gfx.h>
 #include <span>
+#include <type_traits>
 #include <vector>
 
 namespace vt {
 
 class Window;
 class Drawable;
+class StaticBatch;
+class FrameCapture;
+class RenderTarget;
 
 struct UniformBuffer {
 	u32 offset;
@@ -25,14 +30,116 @@ struct UniformBuffer {
 	}
 };
 
+// What happens when a draw doesn't fit in the remaining batch capacity
+enum class OverflowPolicy : u8 {
+	Flush = 0, // Submit the batch so far and resume the pass
+	Grow,	   // Double the full arenas, GPU buffers follow on the next flush
+	Drop,	   // Log an error and skip the draw
+};
+
+struct BatcherSettings {
+	u32 max_vertices {};  // Zero selects the default capacity
+	u32 max_commands {};  // Zero selects the default capacity
+	u32 max_instances {}; // Zero selects the default capacity
+	u32 max_indices {};	  // Zero sizes it for quads: 6 indices per 4 vertices
+	u32 buffer_count {};  // Depth of the GPU buffers ring, zero selects the default
+	u32 context_count {}; // Recording contexts handed out to worker threads
+	bool indexed {};	  // Stream an index buffer next to the vertices
+	bool deferred {};	  // Sort draws by state on flush instead of merging on draw
+	// Merge by chaining index ranges, gathered on flush, instead of moving the
+	// elements of merged draws next to each other. Requires indexed mode.
+	bool indirect_merge {};
+	bool depth_sorted {}; // Depth test opaque draws, see `apply_translucent`
+	OverflowPolicy overflow {};
+	// Layout of the streamed vertices, applied pipelines must read the same one
+	VertexFormat vertex_format {};
+};
+
+struct BufferRingStats {
+	u64 flushes;			// Flushes that uploaded through the ring
+	u64 wraps;				// Times the ring cycled back to its first buffer
+	u64 frame_reuses;		// Flushes that appended to a buffer written this frame
+	u64 last_frame_reuses;	// Flushes that wrote a buffer the previous frame used
+	u64 replacements;		// Buffers remade since a frame filled them
+};
+
+// Frames kept by the batcher, see `RenderBatcher::get_stats`
+constexpr u32 FRAME_STATS_HISTORY = 16;
+
+// Batching counters of a single frame, frames end on `sg_commit`
+struct FrameStats {
+	u32 draw_calls;		  // Draws issued to sokol
+	u32 merged_prev;	  // Draws merged backward into a previous command
+	u32 merged_next;	  // Draws merged forward, pulling a previous command
+	u32 skipped_commands; // Commands emptied by merges
+	u32 pipeline_changes;
+	u32 binding_changes;
+	u32 uniform_changes;
+	u32 vertices_uploaded;
+	u64 bytes_uploaded;	  // Vertices, indices and instances
+	u32 overflow_drops;	  // Allocations refused because an arena was full
+	u32 peak_vertices;	  // Most vertices recorded by a single flush
+	u32 peak_commands;	  // Most commands recorded by a single flush
+};
+
 struct BatchState {
 	Point framesize;
 	Rect viewport;
 	Rect scissor;
+	// Visible part of the viewport and scissor in clip space, as corners
+	Rect clip { -1.0, -1.0, 1.0, 1.0 };
 	Mat4 proj;
 	View view;
 	sg_pipeline pipeline;
 	UniformBuffer uniform;
+	u8 layer;
+	bool translucent;
+
+	friend class RenderBatcher;
+};
+
+/**
+ * Records draws from a worker thread into its own arenas, which are stitched
+ * into the RenderBatcher upload on flush.
+ *
+ * NOTE: A drawable must not be recorded by two contexts at the same time,
+ * since its transform is cached on first use
+ */
+class BatchContext {
+public:
+	BatchContext() = default;
+
+	void draw(const Drawable& drawable);
+
+	void apply_view(const View& view);
+	void apply_layer(u8 layer);
+	void apply_translucent(bool translucent);
+
+	void clear();
+
+private:
+	struct ContextDraw {
+		Rect region;
+		Rect viewport;
+		Rect scissor;
+		TexturesUniform textures;
+		sg_pipeline pipeline;
+		UniformBuffer uniform;
+		sg_primitive_type primitive;
+		u8 layer;
+		bool translucent;
+		f32 depth;
+		u32 vertex_idx;
+		u32 vertex_count;
+		u32 index_idx;
+		u32 index_count;
+	};
+
+	BatchState m_state {};
+	bool m_indexed {};
+	std::vector<Vertex> m_vertices;
+	std::vector<u16> m_indices;
+	std::vector<ContextDraw> m_draws;
 
 	friend class RenderBatcher;
 };
@@ -44,28 +151,91 @@ public:
 	RenderBatcher(const RenderBatcher&) = delete;
 	RenderBatcher& operator=(const RenderBatcher&) = delete;
 
-	bool init(u32 max_vertices = 0, u32 max_commands = 0);
+	bool init(const BatcherSettings& settings = {});
 	void terminate();
 
 	// Drawing state manipulation
 	void draw(const Drawable& drawable);
+	// Draws `mesh` once per instance, transforms are applied by the GPU so the
+	// mesh vertices are uploaded once in local space.
+	// NOTE: Always uses the instanced sprite pipeline, ignoring state one
+	void draw_instanced(const Drawable& mesh, std::span<const SpriteInstance> instances);
+	// Draws a baked batch from its own buffers, one command per baked state
+	void draw(const StaticBatch& batch);
 
 	void set_target(const Window& window);
 	void set_target(const sg_attachments& attachments);
+	void set_target(const RenderTarget& target);
+	// Load, clear and store actions of the passes begun by the next flushes
+	void set_pass_action(const sg_pass_action& action);
+	[[nodiscard]] const sg_pass_action& get_pass_action() const;
+
+	// Sets the pipeline of the next draws along with its vertex uniform block,
+	// an invalid pipeline goes back to the common one.
+	// NOTE: Identical blocks share their storage within a frame, so the draws
+	// using them can still be merged
+	void apply_pipeline(sg_pipeline pipeline, std::span<const u8> uniforms = {});
+
+	template <typename T>
+		requires std::is_trivially_copyable_v<T>
+	void apply_pipeline(sg_pipeline pipeline, const T& uniforms) {
+		apply_pipeline(pipeline, std::span((const u8 *)&uniforms, sizeof(T)));
+	}
 
 	void apply_view(const View& view);
 	void apply_viewport(f32 x, f32 y, f32 w, f32 h);
 	void apply_scissor(f32 x, f32 y, f32 w, f32 h);
+	// Lower layers are drawn first, only honored in deferred mode
+	void apply_layer(u8 layer);
+	// In depth sorted mode, the opaque draws of a layer are drawn first front to
+	// back with the depth written, so they are batched regardless of overlap.
+	// Its translucent ones follow back to front, blended and only depth tested.
+	// NOTE: Overlapping opaque draws must not share the same depth
+	void apply_translucent(bool translucent);
+
+	// Hands out the context of a worker slot, capturing the current drawing
+	// state. Contexts are stitched in slot order after the batcher's commands.
+	BatchContext& get_context(u32 slot);
 
 	void reset();
 	void flush();
 
+	// Records every flush of the next frame into `capture`, which must outlive it
+	void capture_frame(FrameCapture& capture);
+	// Flushes the batches of a capture to the current target as one pass, in
+	// place of any pending draw. The batcher must be made with the capture
+	// settings.
+	bool replay(const FrameCapture& capture);
+
+	// Settings once initialized, with defaults and fixes applied
+	[[nodiscard]] const BatcherSettings& get_settings() const;
+	[[nodiscard]] const BufferRingStats& get_ring_stats() const;
+	// Counters of the last committed frame, or of the frame `frames_ago` before
+	// it. Frames older than the history read as zero.
+	[[nodiscard]] const FrameStats& get_stats(u32 frames_ago = 0) const;
+
 private:
 	static constexpr i32 _DEFAULT_MAX_VERTICES = 65536;
 	static constexpr i32 _DEFAULT_MAX_COMMANDS = 16384;
+	// A draw, and the viewport and scissor an overflow flush restores before it
+	static constexpr u32 _DRAW_COMMANDS = 3;
+	static constexpr i32 _DEFAULT_MAX_INSTANCES = 16384;
+	static constexpr i32 _UNIFORM_BUFFER_SIZE = 65536;
+	static constexpr i32 _UNIFORM_ALIGNMENT = 16;
+	static constexpr i32 _UNIFORM_CACHE_SIZE = 256; // Must be a power of two
+	static constexpr i32 _DEFAULT_BUFFER_COUNT = 3;
+	static constexpr i32 _MAX_BUFFER_COUNT = 8;
+	static constexpr i32 _MAX_INDEXED_VERTICES = 65536; // Addressable by u16
 	static constexpr i32 _MAX_MOVE_VERTICES = 512;
 	static constexpr i32 _MAX_STACK_DEPTH = 64;
-	static constexpr i32 _BATCH_MERGE_DEPTH = 8;
+	static constexpr i32 _MERGE_GRID_SIZE = 64;
+	static constexpr i32 _MERGE_STATE_SLOTS = 1024; // Must be a power of two
+	static constexpr i32 _MERGE_STATE_PROBES = 8;
+	static constexpr u32 _MERGE_SCAN_DEPTH = 16;
+	static constexpr i32 _ORDER_GRID_SIZE = 32;
+	static constexpr u32 _MAX_ORDER_LEVEL = 0xffffff; // 24 bits of the sort key
+	static constexpr i32 _DEPTH_BANDS = 256;
+	static constexpr i32 _DEFAULT_TEXTURE_GROUPS = 64;
 
 	enum BatchCommandType : u8 {
 		None = 0,
@@ -79,8 +249,39 @@ private:
 		Rect region;
 		UniformBuffer uniform;
 		TexturesUniform textures;
-		u32 vertex_idx;
-		u32 vertex_count;
+		// Buffers of retained geometry, stream buffers are used if invalid
+		sg_buffer vertex_buf;
+		sg_buffer index_buf;
+		u32 element_idx;	// First index if indexed, first vertex otherwise
+		u32 element_count;   // Index count if indexed, vertex count otherwise
+		u32 instance_idx;	// First instance, instanced draws only
+		u32 instance_count; // Zero if not instanced
+		u32 texture_group;	// One past its group of slot textures, zero if none
+		u32 index_range;	// One past its last chained range, zero if contiguous
+		u64 sort_key;		// Layer | overlap level | state hash, deferred mode only
+		bool mergeable;		// Only plain draws from the streams are concatenated
+	};
+
+	// Where a draw lands once sorted
+	struct DrawOrder {
+		u8 layer;
+		bool translucent;
+		f32 depth; // Clip space depth, -1 is the nearest
+	};
+
+	// Indirect merge mode: part of the indices of a merged command, each range
+	// links to the one drawn before it
+	struct IndexRange {
+		u32 first;
+		u32 count;
+		u32 prev; // One past the previous range, zero for the first one
+	};
+
+	// Textures sampled by slot by the multi-texture draws of a flush, a new
+	// group is opened once every slot is taken
+	struct TextureGroup {
+		TexturesUniform textures; // Unused slots hold the common texture
+		u32 count;
 	};
 
 	struct BatchCommand {
@@ -93,22 +294,168 @@ private:
 	};
 
 	bool m_is_valid = false;
+	BatcherSettings m_settings {};
 	sg_pass m_cur_pass {};
 	BatchState m_state {};
-	sg_buffer m_vertex_buf;
+
+	// Pass actions set by the user, restored once a pass resumed by an overflow
+	// flush is done
+	sg_pass_action m_pass_action {};
+	bool m_pass_resumed {};
+
+	// Stream buffers are rotated on every flush, each frame starting after the
+	// buffers of the previous one so it never writes one the GPU may still be
+	// reading. A frame out of buffers appends to its last one.
+	std::array<sg_buffer, _MAX_BUFFER_COUNT> m_vertex_bufs {};
+	std::array<sg_buffer, _MAX_BUFFER_COUNT> m_index_bufs {};
+	std::array<sg_buffer, _MAX_BUFFER_COUNT> m_instance_bufs {};
+	bool m_stale_buffers {};		// Arenas outgrew the GPU buffers
+	u32 m_frame_buffer {};			// First buffer of the frame being recorded
+	u32 m_frame_buffers {};			// Buffers written by the frame being recorded
+	u32 m_last_frame_buffers {};	// Buffers written by the previous frame
+	BufferRingStats m_ring_stats {};
+
+	FrameStats m_frame_stats {}; // Frame being recorded
+	std::array<FrameStats, FRAME_STATS_HISTORY> m_stats_history {};
+	u32 m_stats_frame {}; // Slot of the last committed frame
 
 	u32 m_cur_vertex {};
+	u32 m_cur_index {};
 	u32 m_cur_command {};
+	u32 m_cur_instance {};
 	u32 m_cur_uniform {};
 	std::vector<Vertex> m_vertices;
+	// Only the arena of the vertex format in use is allocated
+	std::vector<CompactVertex> m_compact_vertices;
+	std::vector<MultiTextureVertex> m_multi_vertices;
+	std::vector<u16> m_indices;
 	std::vector<BatchCommand> m_commands;
+	std::vector<SpriteInstance> m_instances;
 	std::vector<u8> m_uniform_buffer;
+	std::vector<TextureGroup> m_texture_groups;
+	std::vector<IndexRange> m_index_ranges;
+
+	// Uniform blocks written this frame, looked up by hash with linear probing
+	struct UniformSlot {
+		u64 hash;
+		UniformBuffer uniform; // Zero sized if the slot is free
+	};
+
+	std::array<UniformSlot, _UNIFORM_CACHE_SIZE> m_uniform_cache {};
+	std::vector<BatchContext> m_contexts;
+
+	// Deferred mode: draws are assigned an overlap level while recording, which
+	// keeps overlapping draws with different state in submission order once
+	// sorted. Each cell of the grid covers a slice of the NDC space.
+	struct OrderCell {
+		u32 level; // One past the highest level drawn over this cell, 0 if empty
+		u32 state; // State hash of the draws at that level
+		bool mixed; // Draws at that level don't share a single state
+	};
+
+	struct SortEntry {
+		u64 key;
+		u32 command_idx;
+	};
+
+	std::array<OrderCell, _ORDER_GRID_SIZE * _ORDER_GRID_SIZE> m_order_grid {};
+	std::vector<SortEntry> m_sort_entries;
+	std::vector<SortEntry> m_sort_scratch;
+	std::vector<BatchCommand> m_sorted_commands;
+	std::vector<u16> m_sorted_indices;
+
+	// Immediate mode: latest command drawn over each cell of the grid, and latest
+	// command of each state, so a draw finds what it can merge with without
+	// walking back over the commands. Both hold a command index plus one, 0 if
+	// there's none.
+	struct MergeSlot {
+		u32 state; // State hash
+		u32 command;
+	};
+
+	std::array<u32, _MERGE_GRID_SIZE * _MERGE_GRID_SIZE> m_merge_grid {};
+	std::array<MergeSlot, _MERGE_STATE_SLOTS> m_merge_states {};
+	u32 m_merge_barrier {}; // First command past the last viewport or scissor change
+
+	FrameCapture *m_capture {};	    // Recording the current frame
+	FrameCapture *m_capture_next {}; // Recording from the next frame on
+
+	bool _make_stream_buffers();
+	void _destroy_stream_buffers();
+	bool _make_ring_slot(u32 slot);
+	void _destroy_ring_slot(u32 slot);
+	bool _submit();
+	// Pass split over several submits: the first clears and stores, the next
+	// ones load back what was drawn, the user's actions are restored after
+	void _store_pass();
+	void _load_pass();
+	void _restore_pass();
 
-	bool _try_merge_command(const DrawCommand& draw);
+	void _reserve(u32 vertices, u32 indices, u32 instances = 0);
+	bool _has_room(u32 vertices, u32 indices, u32 instances) const;
+	bool _grow_arenas(u32 vertices, u32 indices, u32 instances);
+	void _flush_overflow();
+	void _submit_draw(
+		DrawCommand draw,
+		sg_primitive_type primitive,
+		const DrawOrder& order,
+		u32 vertex_count,
+		u32 index_count
+	);
+	DrawPass _get_draw_pass(bool translucent) const;
+	DrawOrder _make_draw_order(f32 depth) const;
+	void _stitch_contexts();
+	void _apply_target(const Rect& viewport, const Rect& scissor);
+	void _update_clip();
+	void _set_offscreen_target(const sg_attachments& attachments, Point size);
 
-	std::span<Vertex> _get_vertices(u32 count);
+	// Cells of a grid slicing the NDC space that a region covers
+	struct GridRange {
+		i32 x1, y1, x2, y2;
+	};
+
+	static GridRange _get_grid_range(const Rect& region, i32 grid_size);
+	static u32 _hash_state(const DrawCommand& draw);
+	static bool _has_same_state(const DrawCommand& a, const DrawCommand& b);
+	void _split_draws();
+
+	bool _try_merge_command(const DrawCommand& draw, u32 state);
+	void _track_command(u32 command_idx, u32 state);
+	MergeSlot& _get_merge_slot(u32 state);
+	u32 _find_merge_overlap(const Rect& region) const;
+	void _mark_merge_grid(const Rect& region, u32 command);
+	void _reset_merge_index();
+
+	u64 _make_sort_key(const DrawCommand& draw, const DrawOrder& order, u32 state);
+	void _reset_order_grid();
+	u32 _sort_commands(u32 command_count);
+	void _sort_entries(u32 count);
+	void _rotate_elements(u32 first, u32 middle, u32 last);
+	void _chain_index_range(DrawCommand& draw, u32 first, u32 count);
+	u32 _gather_indices(u32 command_count);
+
+	// Calls `fn` with the vertex arena of the configured format
+	template <typename Fn>
+	decltype(auto) _visit_vertices(Fn&& fn);
+	template <typename Fn>
+	decltype(auto) _visit_vertices(Fn&& fn) const;
+
+	u32 _vertex_capacity() const;
+	usize _vertex_stride() const;
+	const u8 *_vertex_data() const;
+	template <typename V>
+	std::span<V> _get_vertices(std::vector<V>& arena, u32 count);
+	u8 _get_texture_slot(const Texture& texture);
+	void _assign_texture_slot(DrawCommand& draw, u32 vertex_idx, u32 vertex_count);
+	std::span<u16> _get_indices(u32 count);
+	std::span<SpriteInstance> _get_instances(u32 count);
+	UniformBuffer _push_uniform(std::span<const u8> data);
 	BatchCommand *_next_command();
 	BatchCommand *_prev_command(u32 depth);
+
+	static void _commit_listener(void *usrdata);
+
+	friend class FrameCapture;
 };
 
 } // namespace vt
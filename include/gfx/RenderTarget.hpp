@@ -0,0 +1,96 @@
+#ifndef _VT_GFX_RENDERTARGET_HPP
+#define _VT_GFX_RENDERTARGET_HPP
+
+#include "gfx/common.hpp"
+#include "math/Vec2i.hpp"
+
+#include <sokol/sokol_gfx.h>
+#include <vector>
+
+namespace vt {
+
+struct RenderTargetDesc {
+	i32 width;
+	i32 height;
+	sg_pixel_format color_format; // Default selects the environment one
+	sg_pixel_format depth_format; // Default selects the environment one, none skips it
+	i32 sample_count;			  // Zero selects one, multisampled targets are resolved
+
+	constexpr bool operator==(const RenderTargetDesc& other) const {
+		return width == other.width && height == other.height
+			&& color_format == other.color_format
+			&& depth_format == other.depth_format
+			&& sample_count == other.sample_count;
+	}
+};
+
+/**
+ * Offscreen color and depth images along with the attachments that render to
+ * them. Like sokol resources it's a handle, copies refer to the same images.
+ */
+class RenderTarget {
+public:
+	RenderTarget() = default;
+
+	bool create(const RenderTargetDesc& desc);
+	void destroy();
+
+	[[nodiscard]] bool is_valid() const;
+	[[nodiscard]] const RenderTargetDesc& get_desc() const;
+	[[nodiscard]] Point get_size() const;
+	[[nodiscard]] sg_attachments get_attachments() const;
+	// Color image to sample once rendered, the resolved one if multisampled
+	[[nodiscard]] Texture get_texture() const;
+
+private:
+	RenderTargetDesc m_desc {};
+	sg_image m_color_img {};
+	sg_image m_resolve_img {};
+	sg_image m_depth_img {};
+	sg_attachments m_attachments {};
+};
+
+/**
+ * Recycles render targets by size and format, so offscreen passes acquired on
+ * every frame reuse the same GPU resources.
+ *
+ * NOTE: A released target is only handed out again from the next frame on, as
+ * draws sampling it may still be pending in a batcher. Targets unused for a
+ * while are destroyed.
+ */
+class RenderTargetPool {
+public:
+	RenderTargetPool() = default;
+
+	RenderTargetPool(const RenderTargetPool&) = delete;
+	RenderTargetPool& operator=(const RenderTargetPool&) = delete;
+
+	bool init();
+	// Destroys every target, acquired ones included
+	void terminate();
+
+	// Returns an invalid target if none could be made
+	RenderTarget acquire(const RenderTargetDesc& desc);
+	void release(const RenderTarget& target);
+
+	[[nodiscard]] u32 get_target_count() const;
+
+private:
+	static constexpr u64 _MAX_IDLE_FRAMES = 120;
+
+	struct PoolEntry {
+		RenderTarget target;
+		u64 released_frame;
+		bool acquired;
+	};
+
+	std::vector<PoolEntry> m_entries;
+	u64 m_frame {};
+	bool m_is_valid {};
+
+	static void _commit_listener(void *usrdata);
+};
+
+} // namespace vt
+
+#endif
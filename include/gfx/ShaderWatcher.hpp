@@ -0,0 +1,35 @@
+#ifndef _VT_GFX_SHADERWATCHER_HPP
+#define _VT_GFX_SHADERWATCHER_HPP
+
+#include "types.hpp"
+
+namespace vt {
+
+/**
+ * Watches `VT_SHADER_DIR` and reloads the shaders made by `load_shader` when
+ * their files are written, so they can be edited while the engine runs.
+ *
+ * NOTE: Only builds with `VT_HOT_RELOAD_SHADERS` watch anything, it's backed by
+ * inotify. Elsewhere `poll` never reloads a shader.
+ */
+class ShaderWatcher {
+public:
+	ShaderWatcher() = default;
+
+	ShaderWatcher(const ShaderWatcher&) = delete;
+	ShaderWatcher& operator=(const ShaderWatcher&) = delete;
+
+	bool init();
+	void terminate();
+
+	// Reloads the shaders whose files changed since the last call, returns how
+	// many changed. Must be called outside of a pass.
+	u32 poll();
+
+private:
+	i32 m_fd { -1 };
+};
+
+} // namespace vt
+
+#endif
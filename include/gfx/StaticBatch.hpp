@@ -0,0 +1,57 @@
+#ifndef _VT_GFX_STATICBATCH_HPP
+#define _VT_GFX_STATICBATCH_HPP
+
+#include "gfx/common.hpp"
+#include "math/Rect.hpp"
+
+#include <sokol/sokol_gfx.h>
+#include <vector>
+
+namespace vt {
+
+class Drawable;
+
+/**
+ * Bakes drawables that never move into immutable GPU buffers, so drawing them
+ * costs neither transforms nor uploads once baked.
+ *
+ * NOTE: Drawables are baked with their current transform and drawn in the order
+ * they were added, always with the static pipeline
+ */
+class StaticBatch {
+public:
+	StaticBatch() = default;
+
+	StaticBatch(const StaticBatch&) = delete;
+	StaticBatch& operator=(const StaticBatch&) = delete;
+
+	void add(const Drawable& drawable);
+	// Uploads what was added and releases the CPU copy
+	bool bake();
+	// Destroys the GPU buffers, the batch can be filled again
+	void clear();
+
+	[[nodiscard]] bool is_baked() const;
+
+private:
+	struct StaticCommand {
+		Rect bounds; // World space area covered by the command
+		TexturesUniform textures;
+		sg_pipeline pipeline;
+		sg_primitive_type primitive;
+		u32 index_idx;
+		u32 index_count;
+	};
+
+	std::vector<Vertex> m_vertices;
+	std::vector<u32> m_indices;
+	std::vector<StaticCommand> m_commands;
+	sg_buffer m_vertex_buf {};
+	sg_buffer m_index_buf {};
+
+	friend class RenderBatcher;
+};
+
+} // namespace vt
+
+#endif
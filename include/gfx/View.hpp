@@ -31,7 +31,7 @@ public:
 
 private:
 	Vec2 m_center;
-	f32 m_rotation;
+	f32 m_rotation {};
 	f32 m_zoom { 1.0 };
 
 	mutable Mat4 m_transform;
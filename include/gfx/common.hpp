@@ -2,11 +2,20 @@
 #define _VT_GFX_COMMON_HPP
 
 #include "gfx/Color.hpp"
+#include "math/Rect.hpp"
 #include "math/Vec2.hpp"
 #include "math/Vec3.hpp"
 
 #include <array>
 #include <sokol/sokol_gfx.h>
+#include <span>
+#include <string_view>
+
+// Directory `load_shader` reads sources from, relative to the working directory
+// unless the build points it to the source tree
+#if !defined(VT_SHADER_DIR)
+#	define VT_SHADER_DIR "assets/shaders"
+#endif
 
 namespace vt {
 
@@ -16,6 +25,43 @@ enum class VertexAttr : u8 {
 	Pos = 0,
 	UV = 1,
 	Color = 2,
+	TexSlot = 3, // Multi-texture vertices only, instanced pipelines reuse it
+};
+
+// Per-instance attributes follow the vertex ones in the instanced pipeline
+enum class InstanceAttr : u8 {
+	Basis = 3,
+	Origin = 4,
+	UVRect = 5,
+	Color = 6,
+};
+
+// Layout of the vertices read by a pipeline
+enum class VertexFormat : u8 {
+	Standard = 0, // `Vertex`
+	Compact,	  // `CompactVertex`
+	MultiTexture, // `MultiTextureVertex`
+	Count,
+};
+
+// Depth and blending of the builtin pipelines
+enum class DrawPass : u8 {
+	Unsorted = 0, // Drawn in order, no depth test and no blending
+	Opaque,		  // Depth tested and written
+	Translucent,  // Depth tested and alpha blended, the depth isn't written
+	Blended,	  // Drawn in order and alpha blended, no depth test
+	Count,
+};
+
+// Blending of a cached pipeline, replacing the one of its draw pass
+enum class BlendMode : u8 {
+	Pass = 0,	   // Whatever the draw pass sets
+	None,
+	Alpha,
+	Premultiplied, // Colors already multiplied by their alpha
+	Additive,
+	Multiply,
+	Count,
 };
 
 struct Vertex {
@@ -24,6 +70,33 @@ struct Vertex {
 	struct Color color { Color::White };
 };
 
+// 2D vertex, the position has no depth and texcoords are normalized to 16 bits,
+// so they must be within [0, 1]
+struct CompactVertex {
+	Vec2 position;
+	u16 texcoord[2];
+	struct Color color { Color::White };
+
+	CompactVertex() = default;
+	explicit CompactVertex(const Vertex& vertex);
+};
+
+static_assert(sizeof(CompactVertex) == 16);
+
+// Vertex of the batching pipeline, which samples the texture bound to
+// `texture_slot` so draws with different textures can share a draw call
+struct MultiTextureVertex {
+	Vec3 position;
+	Vec2 texcoord;
+	struct Color color { Color::White };
+	u8 texture_slot {};
+
+	MultiTextureVertex() = default;
+	explicit MultiTextureVertex(const Vertex& vertex, u8 slot = 0);
+};
+
+static_assert(sizeof(MultiTextureVertex) == 28);
+
 struct Texture {
 	sg_image img;
 	sg_sampler smp;
@@ -33,12 +106,106 @@ struct Texture {
 	}
 };
 
+// Placement of one instance of a mesh drawn by the instanced sprite pipeline.
+// Mesh vertices are mapped to `origin + x * axis_x + y * axis_y`, texcoords
+// to the `uv_rect` sub-rect and colors are tinted by `color`.
+struct SpriteInstance {
+	Vec2 axis_x { 1.0, 0.0 };
+	Vec2 axis_y { 0.0, 1.0 };
+	Vec2 origin;
+	Rect uv_rect { 0.0, 0.0, 1.0, 1.0 };
+	struct Color color { Color::White };
+};
+
 using TexturesUniform = std::array<Texture, MAX_TEXTURES_SLOTS>;
 
-sg_pipeline_desc init_pipeline_desc(sg_primitive_type primitive, sg_shader shdr);
-sg_pipeline make_pipeline(sg_primitive_type primitive);
+// Render state a cached pipeline is made from, see `get_pipeline`
+struct PipelineState {
+	sg_shader shader {}; // Invalid selects the builtin one of the format
+	sg_primitive_type primitive {};
+	sg_index_type index_type {};
+	VertexFormat format {};
+	DrawPass pass {}; // Depth state and blending
+	BlendMode blend {};
+	sg_cull_mode cull_mode {};
+	bool instanced {}; // Reads `SpriteInstance` from a second buffer
+
+	bool operator==(const PipelineState& other) const {
+		return shader.id == other.shader.id && primitive == other.primitive
+			&& index_type == other.index_type && format == other.format
+			&& pass == other.pass && blend == other.blend
+			&& cull_mode == other.cull_mode && instanced == other.instanced;
+	}
+};
+
+struct PipelineCacheStats {
+	u64 hits;
+	u64 misses;		// Pipelines made on first use, prewarmed ones included
+	u64 late_misses; // Misses once pipelines were prewarmed, they stall a frame
+	u32 pipelines;
+};
+
+// Two triangles over four corners: TL, TR, BR / TL, BR, BL
+constexpr std::array<u16, 6> QUAD_INDICES = { 0, 1, 2, 0, 2, 3 };
+
+sg_pipeline_desc init_pipeline_desc(
+	sg_primitive_type primitive,
+	sg_shader shdr,
+	sg_index_type index_type = SG_INDEXTYPE_NONE,
+	VertexFormat format = VertexFormat::Standard
+);
+// Sets the depth state and blending of `pass` on a pipeline description
+void init_draw_pass(sg_pipeline_desc& desc, DrawPass pass);
+void init_blend_mode(sg_pipeline_desc& desc, BlendMode blend);
+
+// Pipeline of `state`, made on first use and cached for the lifetime of sokol.
+// Invalid if it failed to be made.
+sg_pipeline get_pipeline(const PipelineState& state);
+// Makes the pipelines of `states` ahead of time, like while loading, returns how
+// many are valid. Pipelines made on first use afterwards are reported.
+u32 prewarm_pipelines(std::span<const PipelineState> states);
+[[nodiscard]] const PipelineCacheStats& get_pipeline_cache_stats();
+
+sg_pipeline make_pipeline(
+	sg_primitive_type primitive,
+	sg_index_type index_type = SG_INDEXTYPE_NONE,
+	VertexFormat format = VertexFormat::Standard,
+	DrawPass pass = DrawPass::Unsorted
+);
+
+// Pipeline of the instanced sprite shader, vertices are read from the first
+// buffer and `SpriteInstance` from the second one
+sg_pipeline make_instanced_pipeline(
+	sg_primitive_type primitive,
+	sg_index_type index_type = SG_INDEXTYPE_NONE,
+	VertexFormat format = VertexFormat::Standard,
+	DrawPass pass = DrawPass::Unsorted
+);
+
+// Pipeline of the static shader, for world space vertices indexed by `u32`
+sg_pipeline make_static_pipeline(
+	sg_primitive_type primitive, DrawPass pass = DrawPass::Unsorted
+);
+
+// Shader with the sources of `<name>.vert.glsl` and `<name>.frag.glsl` in
+// `VT_SHADER_DIR`, falling back to those of `desc` if the files can't be read.
+// Loading a name again returns the same shader.
+// NOTE: The handle stays the same across reloads, names pointed to by `desc`
+// must outlive it
+sg_shader load_shader(const char *name, const sg_shader_desc& desc);
+// Reads the files of a loaded shader again and remakes it in place along with its
+// cached pipelines. Keeps the previous sources if the new ones fail to compile,
+// returns whether the shader changed.
+bool reload_shader(std::string_view name);
 
+// Sources are loaded from `common.vert.glsl` and `common.frag.glsl`
 sg_shader make_common_shader();
+// Common shader sampling one of `MAX_TEXTURES_SLOTS` textures per vertex
+sg_shader make_multi_texture_shader();
+// Takes the model-view-projection matrix as its only vertex uniform
+sg_shader make_instanced_shader();
+// Common shader whose vertices still go through a view-projection uniform
+sg_shader make_static_shader();
 Texture make_common_texture();
 
 } // namespace vt
@@ -0,0 +1,54 @@
+#ifndef _VT_GFX_KERNELS_HPP
+#define _VT_GFX_KERNELS_HPP
+
+#include "gfx/common.hpp"
+#include "math/Mat4.hpp"
+#include "math/Rect.hpp"
+
+#include <span>
+
+namespace vt::kernels {
+
+enum class Isa : u8 {
+	Scalar,
+	SSE2,
+	AVX2,
+};
+
+// Best instruction set supported by the running CPU, picked on first use
+[[nodiscard]] Isa get_isa();
+// Forces a kernel variant, clamped to what the CPU supports
+void set_isa(Isa isa);
+
+/**
+ * Transforms the positions of `src` by `mvp` into `dst`, copying texcoords and
+ * colors, and returns the area covered by the transformed positions.
+ * If `indices` isn't null, vertex `i` is read from `src[indices[i]]`.
+ */
+Rect transform_vertices(
+	const Mat4& mvp,
+	std::span<const Vertex> src,
+	const u16 *indices,
+	std::span<Vertex> dst
+);
+// Same as above, packing the transformed vertices into the compact format
+Rect transform_vertices(
+	const Mat4& mvp,
+	std::span<const Vertex> src,
+	const u16 *indices,
+	std::span<CompactVertex> dst
+);
+// Same as above, every vertex of `dst` sampling the first texture slot
+Rect transform_vertices(
+	const Mat4& mvp,
+	std::span<const Vertex> src,
+	const u16 *indices,
+	std::span<MultiTextureVertex> dst
+);
+
+// Area covered by the corners of `rect` once transformed by `mvp`
+Rect transform_rect(const Mat4& mvp, const Rect& rect);
+
+} // namespace vt::kernels
+
+#endif
@@ -25,6 +25,13 @@ public:
 	[[nodiscard]] const Vec2& get_scale() const;
 
 	[[nodiscard]] const Mat4& get_matrix() const;
+	// Changes on every modification, derived classes count their own too. Taken
+	// from a counter shared by every transform, so assigning another object
+	// changes it as well
+	[[nodiscard]] u32 get_revision() const;
+
+protected:
+	void _mark_changed();
 
 private:
 	Vec2 m_origin;
@@ -34,6 +41,9 @@ private:
 
 	mutable Mat4 m_transform;
 	mutable bool m_update_transform { true };
+	u32 m_revision { _next_revision() };
+
+	static u32 _next_revision();
 };
 
 } // namespace vt
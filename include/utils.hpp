@@ -30,6 +30,10 @@
 #	error Could not detect target platform
 #endif
 
+#if defined(__x86_64__) || defined(_M_X64)
+#	define VT_ARCH_X86_64 1
+#endif
+
 #define VT_UNUSED(x) ((void)x)
 
 namespace vt {
@@ -1,9 +1,12 @@
 #include "Engine.hpp"
 
+#include "alloc.hpp"
 #include "gfx/Drawable.hpp"
+#include "gfx/ProgramCache.hpp"
 #include "log.hpp"
 
 #include <SDL3/SDL_events.h>
+#include <SDL3/SDL_filesystem.h>
 #include <SDL3/SDL_init.h>
 #include <SDL3/SDL_timer.h>
 
@@ -51,15 +54,56 @@ Engine::Engine() {
 		return; // [[noreturn]]
 	}
 
-	if (!m_render.init()) {
+	// Linked shader programs are kept between launches, shaders still compile
+	// from source without them
+	if (char *pref_path = SDL_GetPrefPath(nullptr, "vitae")) {
+		program_cache::init(pref_path);
+		SDL_free(pref_path);
+	}
+
+	if (!m_render.init({ .indexed = true })) {
 		vt::log::fatal("[ENGINE] > Failed to initialize Batch Renderer");
 		return; // [[noreturn]]
 	}
 
+	if (!m_targets.init()) {
+		vt::log::fatal("[ENGINE] > Failed to initialize Render Target pool");
+		return; // [[noreturn]]
+	}
+
+	// Shaders still load without it, they just aren't reloaded
+	if (!m_shader_watcher.init()) {
+		vt::log::warn("[ENGINE] > Shader hot reload is unavailable");
+	}
+
+	// Pipelines of the frame loop are made while loading, not when first drawn
+	VertexFormat format = m_render.get_settings().vertex_format;
+	PipelineState states[] = {
+		{ .primitive = SG_PRIMITIVETYPE_TRIANGLES,
+		  .index_type = SG_INDEXTYPE_UINT16,
+		  .format = format },
+		{ .primitive = SG_PRIMITIVETYPE_LINES,
+		  .index_type = SG_INDEXTYPE_UINT16,
+		  .format = format },
+	};
+	if (vt::prewarm_pipelines(states) != std::size(states)) {
+		vt::log::warn("[ENGINE] > Failed to prewarm some pipelines");
+	}
+
+	program_cache::Stats programs = program_cache::get_stats();
+	vt::log::info(
+		"[ENGINE] > Shader programs: {} cached, {} compiled, {} rejected",
+		programs.hits, programs.misses, programs.rejected
+	);
+
 	m_is_valid = true;
 }
 
 Engine::~Engine() {
+	m_capture.clear();
+	m_shader_watcher.terminate();
+	program_cache::terminate();
+	m_targets.terminate();
 	m_render.terminate();
 	_terminate_graphics_driver();
 	m_window.close();
@@ -69,7 +113,94 @@ Engine::~Engine() {
 
 void Engine::run() {
 	assert(m_is_valid);
+	m_should_quit = false;
+	u64 frame = 0;
+
+	// Built once, the frame loop shouldn't touch the heap
+	auto rect = Drawable::make_rect(DrawMode::ModeFill, 128, 128, 32, 32);
+	u32 drawn_revision = rect.get_revision();
+
+	while (!m_should_quit) {
+		bool is_dirty = m_redraw_requested || m_capturing
+					 || rect.get_revision() != drawn_revision;
+
+		// Blocks until input arrives unless a frame is already due
+		bool is_idle = m_redraw_mode == RedrawMode::OnDemand && !is_dirty;
+		if (_process_events(is_idle)) {
+			is_dirty = true;
+		}
+
+		// Reloading reads files, so it's kept out of the frame's allocations
+		if (m_shader_watcher.poll() > 0) {
+			is_dirty = true;
+		}
+
+		if (m_capturing && m_capture.is_complete()) {
+			if (m_capture.save(_CAPTURE_PATH)) {
+				vt::log::info("[ENGINE] > Frame captured to '{}'", _CAPTURE_PATH);
+			}
+			m_capturing = false;
+		}
+
+		if (m_should_quit || (m_redraw_mode == RedrawMode::OnDemand && !is_dirty)) {
+			continue;
+		}
+
+		alloc::begin_frame();
+
+		m_render.set_target(m_window);
+		m_render.draw(rect);
+		drawn_revision = rect.get_revision();
+		m_redraw_requested = false;
+
+		m_render.flush();
+		m_window.present();
+
+		// Capturing records into growing arrays, so those frames are let go
+		alloc::Counters allocs = alloc::end_frame();
+		if (allocs.allocations > 0 && frame >= _ALLOC_WARMUP_FRAMES && !m_capturing) {
+			vt::log::warn(
+				"[ENGINE] > {} heap allocations ({} bytes) during frame {}",
+				allocs.allocations, allocs.bytes, frame
+			);
+			assert(false);
+		}
+
+		frame += 1;
+	}
+}
+
+RenderTargetPool& Engine::get_target_pool() {
+	assert(m_is_valid);
+	return m_targets;
+}
+
+void Engine::set_redraw_mode(RedrawMode mode) {
+	m_redraw_mode = mode;
+	m_redraw_requested = true;
+}
+
+void Engine::request_redraw() {
+	m_redraw_requested = true;
+}
+
+void Engine::replay(const char *path) {
+	assert(m_is_valid);
+
+	if (!m_capture.load(path)) {
+		return;
+	}
+
+	// The capture is laid out for the settings it was recorded with
+	m_render.terminate();
+	if (!m_render.init(m_capture.get_settings()) || !m_capture.make_resources()) {
+		vt::log::error("[ENGINE] > Failed to prepare the replay of '{}'", path);
+		return;
+	}
+
 	bool should_quit = false;
+	u64 replay_ticks = 0;
+	u32 frames = 0;
 
 	while (!should_quit) {
 		SDL_Event event;
@@ -79,13 +210,52 @@ void Engine::run() {
 			}
 		}
 
-		auto rect = Drawable::make_rect(DrawMode::ModeFill, 128, 128, 32, 32);
-
+		u64 start = SDL_GetPerformanceCounter();
 		m_render.set_target(m_window);
-		m_render.draw(rect);
+		if (!m_render.replay(m_capture)) {
+			return;
+		}
+		replay_ticks += SDL_GetPerformanceCounter() - start;
 
-		m_render.flush();
 		m_window.present();
+
+		frames += 1;
+		if (frames == _REPLAY_REPORT_FRAMES) {
+			f64 ms = replay_ticks * 1000.0 / SDL_GetPerformanceFrequency() / frames;
+			vt::log::info("[ENGINE] > Replay: {:.3f} ms per frame", ms);
+			replay_ticks = 0;
+			frames = 0;
+		}
+	}
+}
+
+bool Engine::_process_events(bool wait) {
+	bool received = false;
+	SDL_Event event;
+
+	// Woken up after a while anyway, as drawables may change without an event
+	if (wait && SDL_WaitEventTimeout(&event, _IDLE_WAIT_MS)) {
+		_handle_event(event);
+		received = true;
+	}
+
+	while (SDL_PollEvent(&event)) {
+		_handle_event(event);
+		received = true;
+	}
+
+	return received;
+}
+
+void Engine::_handle_event(const SDL_Event& event) {
+	if (event.type == SDL_EVENT_QUIT) {
+		m_should_quit = true;
+	}
+
+	// Captures the next frame for `replay`
+	if (event.type == SDL_EVENT_KEY_DOWN && event.key.key == SDLK_F12) {
+		m_render.capture_frame(m_capture);
+		m_capturing = true;
 	}
 }
 
@@ -0,0 +1,117 @@
+#include "alloc.hpp"
+
+#include "utils.hpp"
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+using namespace vt;
+
+static std::atomic<u64> s_allocations { 0 };
+static std::atomic<u64> s_frees { 0 };
+static std::atomic<u64> s_bytes { 0 };
+static alloc::Counters s_frame_start {};
+
+alloc::Counters alloc::get_counters() {
+	return Counters {
+		.allocations = s_allocations.load(std::memory_order_relaxed),
+		.frees = s_frees.load(std::memory_order_relaxed),
+		.bytes = s_bytes.load(std::memory_order_relaxed),
+	};
+}
+
+void alloc::begin_frame() {
+	s_frame_start = get_counters();
+}
+
+alloc::Counters alloc::end_frame() {
+	Counters now = get_counters();
+	return Counters {
+		.allocations = now.allocations - s_frame_start.allocations,
+		.frees = now.frees - s_frame_start.frees,
+		.bytes = now.bytes - s_frame_start.bytes,
+	};
+}
+
+#if VT_TRACK_ALLOCATIONS
+
+// Replaces the global allocation functions, the array and nothrow forms call
+// these ones by default
+
+static void *_allocate(std::size_t size, std::size_t align) {
+	s_allocations.fetch_add(1, std::memory_order_relaxed);
+	s_bytes.fetch_add(size, std::memory_order_relaxed);
+
+	size = size > 0 ? size : 1;
+	while (true) {
+		void *ptr = nullptr;
+		if (align <= __STDCPP_DEFAULT_NEW_ALIGNMENT__) {
+			ptr = std::malloc(size);
+		} else {
+#	if VT_PLATFORM_WINDOWS
+			ptr = _aligned_malloc(size, align);
+#	else
+			// Size must be a multiple of the alignment
+			ptr = std::aligned_alloc(align, (size + align - 1) / align * align);
+#	endif
+		}
+
+		if (ptr) {
+			return ptr;
+		}
+
+		std::new_handler handler = std::get_new_handler();
+		if (!handler) {
+			throw std::bad_alloc();
+		}
+		handler();
+	}
+}
+
+static void _free(void *ptr, std::size_t align) {
+	if (!ptr) {
+		return;
+	}
+
+	s_frees.fetch_add(1, std::memory_order_relaxed);
+
+#	if VT_PLATFORM_WINDOWS
+	if (align > __STDCPP_DEFAULT_NEW_ALIGNMENT__) {
+		_aligned_free(ptr);
+		return;
+	}
+#	else
+	VT_UNUSED(align);
+#	endif
+
+	std::free(ptr);
+}
+
+void *operator new(std::size_t size) {
+	return _allocate(size, __STDCPP_DEFAULT_NEW_ALIGNMENT__);
+}
+
+void *operator new(std::size_t size, std::align_val_t align) {
+	return _allocate(size, (std::size_t)align);
+}
+
+void operator delete(void *ptr) noexcept {
+	_free(ptr, __STDCPP_DEFAULT_NEW_ALIGNMENT__);
+}
+
+void operator delete(void *ptr, std::size_t size) noexcept {
+	VT_UNUSED(size);
+	_free(ptr, __STDCPP_DEFAULT_NEW_ALIGNMENT__);
+}
+
+void operator delete(void *ptr, std::align_val_t align) noexcept {
+	_free(ptr, (std::size_t)align);
+}
+
+void operator delete(void *ptr, std::size_t size, std::align_val_t align) noexcept {
+	VT_UNUSED(size);
+	_free(ptr, (std::size_t)align);
+}
+
+#endif
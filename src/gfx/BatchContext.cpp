@@ -0,0 +1,71 @@
+#include "gfx/Drawable.hpp"
+#include "gfx/RenderBatcher.hpp"
+
+using namespace vt;
+
+void BatchContext::draw(const Drawable& drawable) {
+	if (drawable.m_vertices.empty()) {
+		return;
+	}
+
+	const Mat4& model = drawable.get_matrix();
+	const Mat4& view = m_state.view.get_transform();
+	Mat4 mvp = m_state.proj * view * model;
+
+	if (!drawable._is_visible(mvp, m_state.clip)) {
+		return;
+	}
+
+	const auto& local_indices = drawable.m_indices;
+
+	// Same layout the batcher would have written, indices are made absolute
+	// once stitched
+	bool expand = !m_indexed && !local_indices.empty();
+
+	ContextDraw draw {};
+	draw.vertex_idx = m_vertices.size();
+	draw.vertex_count = expand ? local_indices.size() : drawable.m_vertices.size();
+	draw.index_idx = m_indices.size();
+	if (m_indexed) {
+		draw.index_count = local_indices.empty() ? draw.vertex_count
+												 : local_indices.size();
+	}
+
+	m_vertices.resize(draw.vertex_idx + draw.vertex_count);
+	m_indices.resize(draw.index_idx + draw.index_count);
+
+	auto vertices = std::span(m_vertices).subspan(draw.vertex_idx, draw.vertex_count);
+	auto indices = std::span(m_indices).subspan(draw.index_idx, draw.index_count);
+	draw.region = drawable._emit_vertices(mvp, expand, vertices);
+	drawable._emit_indices(0, indices);
+
+	draw.viewport = m_state.viewport;
+	draw.scissor = m_state.scissor;
+	draw.textures = drawable.m_textures;
+	draw.pipeline = m_state.pipeline;
+	draw.uniform = m_state.uniform;
+	draw.primitive = drawable.m_primitive;
+	draw.layer = m_state.layer;
+	draw.translucent = m_state.translucent;
+	draw.depth = drawable._get_depth(mvp);
+
+	m_draws.push_back(draw);
+}
+
+void BatchContext::apply_view(const View& view) {
+	m_state.view = view;
+}
+
+void BatchContext::apply_layer(u8 layer) {
+	m_state.layer = layer;
+}
+
+void BatchContext::apply_translucent(bool translucent) {
+	m_state.translucent = translucent;
+}
+
+void BatchContext::clear() {
+	m_vertices.clear();
+	m_indices.clear();
+	m_draws.clear();
+}
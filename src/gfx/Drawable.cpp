@@ -1,14 +1,21 @@
 #include "gfx/Drawable.hpp"
+#include "gfx/kernels.hpp"
 
 #include "log.hpp"
 
+#include <algorithm>
 #include <utility>
 
 using namespace vt;
 
-Drawable::Drawable(sg_primitive_type primitive, const std::span<Vertex>& vertices) {
+Drawable::Drawable(
+	sg_primitive_type primitive,
+	const std::span<Vertex>& vertices,
+	const std::span<const u16>& indices
+) {
 	m_primitive = primitive;
-	m_vertices.assign(vertices.begin(), vertices.end());
+	append_vertices(vertices);
+	m_indices.assign(indices.begin(), indices.end());
 	m_textures[0] = make_common_texture();
 }
 
@@ -29,24 +36,21 @@ Drawable Drawable::make_rect(
 		Vec3(0.0, h, 0.0),	 // Bottom Left
 	};
 
-	std::vector<vt::Vertex> vertices {
+	vt::Vertex vertices[4] = {
 		Vertex(quad[0], quad_uv[0], color), // Top Left
 		Vertex(quad[1], quad_uv[1], color), // Top Right
 		Vertex(quad[2], quad_uv[2], color), // Bottom Right
-
-		Vertex(quad[0], quad_uv[0], color), // Top Left
-		Vertex(quad[2], quad_uv[2], color), // Bottom Right
 		Vertex(quad[3], quad_uv[3], color), // Bottom Left
 	};
 
-	sg_primitive_type primitive;
+	sg_primitive_type primitive {};
 	switch (mode) {
 	case DrawMode::ModeFill:  primitive = SG_PRIMITIVETYPE_TRIANGLES; break;
 	case DrawMode::ModeLines: primitive = SG_PRIMITIVETYPE_LINES; break;
 	default:				  assert(false);
 	}
 
-	Drawable drawable { primitive, vertices };
+	Drawable drawable { primitive, vertices, QUAD_INDICES };
 	drawable.set_origin({ w / 2, h / 2 });
 	drawable.set_position({ x, y, 0.0 });
 
@@ -62,7 +66,29 @@ void Drawable::append_vertices(const std::span<Vertex>& vertices) {
 		return;
 	}
 
+	if (m_vertices.empty()) {
+		const Vec3& first = vertices[0].position;
+		m_bounds = Rect { first.x, first.y, first.x, first.y };
+	}
+
+	for (const auto& vertex : vertices) {
+		m_bounds.x1 = std::min(m_bounds.x1, vertex.position.x);
+		m_bounds.y1 = std::min(m_bounds.y1, vertex.position.y);
+		m_bounds.x2 = std::max(m_bounds.x2, vertex.position.x);
+		m_bounds.y2 = std::max(m_bounds.y2, vertex.position.y);
+	}
+
 	m_vertices.insert(m_vertices.cend(), vertices.begin(), vertices.end());
+	_mark_changed();
+}
+
+void Drawable::append_indices(const std::span<const u16>& indices) {
+	if (indices.empty()) {
+		return;
+	}
+
+	m_indices.insert(m_indices.cend(), indices.begin(), indices.end());
+	_mark_changed();
 }
 
 void Drawable::set_texture(u32 slot, const Texture& texture) {
@@ -72,4 +98,45 @@ void Drawable::set_texture(u32 slot, const Texture& texture) {
 	}
 
 	m_textures[slot] = texture;
+	_mark_changed();
+}
+
+Rect Drawable::_emit_vertices(const Mat4& mvp, bool expand, std::span<Vertex> out) const {
+	const u16 *indices = expand ? m_indices.data() : nullptr;
+	return kernels::transform_vertices(mvp, m_vertices, indices, out);
+}
+
+Rect Drawable::_emit_vertices(
+	const Mat4& mvp, bool expand, std::span<CompactVertex> out
+) const {
+	const u16 *indices = expand ? m_indices.data() : nullptr;
+	return kernels::transform_vertices(mvp, m_vertices, indices, out);
+}
+
+Rect Drawable::_emit_vertices(
+	const Mat4& mvp, bool expand, std::span<MultiTextureVertex> out
+) const {
+	const u16 *indices = expand ? m_indices.data() : nullptr;
+	return kernels::transform_vertices(mvp, m_vertices, indices, out);
+}
+
+bool Drawable::_is_visible(const Mat4& mvp, const Rect& clip) const {
+	// Edges count so that zero-width lines on the border are kept
+	return kernels::transform_rect(mvp, m_bounds).intersects(clip, true);
+}
+
+f32 Drawable::_get_depth(const Mat4& mvp) const {
+	Vec3 center {
+		(m_bounds.x1 + m_bounds.x2) * 0.5f, (m_bounds.y1 + m_bounds.y2) * 0.5f, 0.0
+	};
+	return (mvp * center).z;
+}
+
+void Drawable::_emit_indices(u32 base_vertex, std::span<u16> out) const {
+	// Drawables without indices are drawn in submission order
+	for (u32 i = 0; i < out.size(); i += 1) {
+		u32 index = m_indices.empty() ? i : m_indices[i];
+		assert(index < m_vertices.size());
+		out[i] = base_vertex + index;
+	}
 }
@@ -0,0 +1,523 @@
+#include "gfx/FrameCapture.hpp"
+
+#include "log.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+using namespace vt;
+
+template <typename T>
+static bool _write_array(std::FILE *file, const std::vector<T>& array) {
+	u32 count = array.size();
+	if (std::fwrite(&count, sizeof(u32), 1, file) != 1) {
+		return false;
+	}
+
+	return count == 0 || std::fwrite(array.data(), sizeof(T), count, file) == count;
+}
+
+static u64 _get_bytes_left(std::FILE *file) {
+	long pos = std::ftell(file);
+	if (pos < 0 || std::fseek(file, 0, SEEK_END) != 0) {
+		return 0;
+	}
+
+	long end = std::ftell(file);
+	if (std::fseek(file, pos, SEEK_SET) != 0 || end < pos) {
+		return 0;
+	}
+
+	return end - pos;
+}
+
+template <typename T>
+static bool _read_array(std::FILE *file, std::vector<T>& array) {
+	u32 count = 0;
+	if (std::fread(&count, sizeof(u32), 1, file) != 1) {
+		return false;
+	}
+
+	// A damaged count must not get allocated before the read fails
+	if ((u64)count * sizeof(T) > _get_bytes_left(file)) {
+		return false;
+	}
+
+	array.resize(count);
+	return count == 0 || std::fread(array.data(), sizeof(T), count, file) == count;
+}
+
+static usize _get_vertex_stride(VertexFormat format) {
+	switch (format) {
+	case VertexFormat::Standard:
+		return sizeof(Vertex);
+	case VertexFormat::Compact:
+		return sizeof(CompactVertex);
+	case VertexFormat::MultiTexture:
+		return sizeof(MultiTextureVertex);
+	default:
+		return 0;
+	}
+}
+
+// Ranges are summed in 64 bits so damaged ones can't wrap around
+static bool _fits(u64 idx, u64 count, u64 size) {
+	return idx + count <= size;
+}
+
+bool FrameCapture::save(const char *path) const {
+	assert(m_complete);
+
+	std::FILE *file = std::fopen(path, "wb");
+	if (!file) {
+		vt::log::error("[GFX] | FrameCapture > Failed to open '{}'", path);
+		return false;
+	}
+
+	Header header {
+		.magic = _MAGIC,
+		.version = _VERSION,
+		.command_size = sizeof(BatchCommand),
+		.settings = m_settings,
+	};
+
+	bool written = std::fwrite(&header, sizeof(Header), 1, file) == 1
+				&& _write_array(file, m_batches)
+				&& _write_array(file, m_commands)
+				&& _write_array(file, m_vertices)
+				&& _write_array(file, m_indices)
+				&& _write_array(file, m_instances)
+				&& _write_array(file, m_uniforms)
+				&& _write_array(file, m_texture_groups)
+				&& _write_array(file, m_pipelines)
+				&& _write_array(file, m_images)
+				&& _write_array(file, m_samplers);
+
+	std::fclose(file);
+	if (!written) {
+		vt::log::error("[GFX] | FrameCapture > Failed to write '{}'", path);
+		return false;
+	}
+
+	return true;
+}
+
+bool FrameCapture::load(const char *path) {
+	clear();
+
+	std::FILE *file = std::fopen(path, "rb");
+	if (!file) {
+		vt::log::error("[GFX] | FrameCapture > Failed to open '{}'", path);
+		return false;
+	}
+
+	Header header {};
+	if (std::fread(&header, sizeof(Header), 1, file) != 1 || header.magic != _MAGIC) {
+		vt::log::error("[GFX] | FrameCapture > '{}' is not a frame capture", path);
+		std::fclose(file);
+		return false;
+	}
+
+	if (header.version != _VERSION || header.command_size != sizeof(BatchCommand)) {
+		vt::log::error("[GFX] | FrameCapture > '{}' was made by another build", path);
+		std::fclose(file);
+		return false;
+	}
+
+	bool read = _read_array(file, m_batches)
+			 && _read_array(file, m_commands)
+			 && _read_array(file, m_vertices)
+			 && _read_array(file, m_indices)
+			 && _read_array(file, m_instances)
+			 && _read_array(file, m_uniforms)
+			 && _read_array(file, m_texture_groups)
+			 && _read_array(file, m_pipelines)
+			 && _read_array(file, m_images)
+			 && _read_array(file, m_samplers);
+
+	std::fclose(file);
+	if (!read) {
+		vt::log::error("[GFX] | FrameCapture > '{}' is truncated", path);
+		clear();
+		return false;
+	}
+
+	m_settings = header.settings;
+	if (!_check_ranges()) {
+		vt::log::error("[GFX] | FrameCapture > '{}' has ranges out of bounds", path);
+		clear();
+		return false;
+	}
+
+	m_complete = true;
+	return true;
+}
+
+bool FrameCapture::make_resources() {
+	assert(m_complete && !m_has_resources);
+
+	Texture common = make_common_texture();
+
+	for (const auto& captured : m_images) {
+		if (captured.common) {
+			m_replay_images.push_back(common.img);
+			continue;
+		}
+
+		// Only the size matters to the replay, contents are left blank
+		sg_image_desc desc {};
+		desc.width = captured.width;
+		desc.height = captured.height;
+		desc.pixel_format = SG_PIXELFORMAT_RGBA8;
+		desc.usage.dynamic_update = true;
+		desc.label = "vt_frame_capture.image";
+
+		sg_image img = sg_make_image(&desc);
+		if (sg_query_image_state(img) != SG_RESOURCESTATE_VALID) {
+			vt::log::error("[GFX] | FrameCapture > Failed to make a replay image");
+			sg_destroy_image(img);
+			m_replay_images.push_back(common.img);
+			continue;
+		}
+
+		m_replay_images.push_back(img);
+	}
+
+	for (const auto& captured : m_samplers) {
+		if (captured.common) {
+			m_replay_samplers.push_back(common.smp);
+			continue;
+		}
+
+		sg_sampler_desc desc = captured.desc;
+		desc.label = "vt_frame_capture.sampler";
+
+		sg_sampler smp = sg_make_sampler(&desc);
+		if (sg_query_sampler_state(smp) != SG_RESOURCESTATE_VALID) {
+			vt::log::error("[GFX] | FrameCapture > Failed to make a replay sampler");
+			sg_destroy_sampler(smp);
+			m_replay_samplers.push_back(common.smp);
+			continue;
+		}
+
+		m_replay_samplers.push_back(smp);
+	}
+
+	// Built-in pipelines are cached by their factories, so they are not owned
+	bool has_custom = false;
+	auto remake_pipeline = [&](sg_pipeline pipeline, UniformBuffer& uniform) {
+		auto it = std::find_if(
+			m_pipelines.begin(), m_pipelines.end(),
+			[&](const CapturedPipeline& captured) { return captured.id == pipeline.id; }
+		);
+		if (it == m_pipelines.end()) {
+			return sg_pipeline {};
+		}
+
+		switch (it->kind) {
+		case PipelineKind::Instanced:
+			return vt::make_instanced_pipeline(
+				it->primitive, it->index_type, m_settings.vertex_format, it->pass
+			);
+		case PipelineKind::Custom:
+			has_custom = true;
+			uniform = UniformBuffer {}; // The common shader takes no uniforms
+			[[fallthrough]];
+		default:
+			return vt::make_pipeline(
+				it->primitive, it->index_type, m_settings.vertex_format, it->pass
+			);
+		}
+	};
+
+	for (auto& cmd : m_commands) {
+		if (cmd.type != RenderBatcher::BatchCommandType::Draw) {
+			continue;
+		}
+
+		auto& draw = cmd.args.draw;
+		draw.pipeline = remake_pipeline(draw.pipeline, draw.uniform);
+		for (auto& texture : draw.textures) {
+			_remap_texture(texture);
+		}
+	}
+
+	for (auto& group : m_texture_groups) {
+		for (auto& texture : group.textures) {
+			_remap_texture(texture);
+		}
+	}
+
+	if (has_custom) {
+		vt::log::warn("[GFX] | FrameCapture > Custom pipelines replay as the common one");
+	}
+
+	m_has_resources = true;
+	return true;
+}
+
+void FrameCapture::destroy_resources() {
+	if (!m_has_resources) {
+		return;
+	}
+
+	Texture common = make_common_texture();
+	for (sg_image img : m_replay_images) {
+		if (img.id != common.img.id) {
+			sg_destroy_image(img);
+		}
+	}
+	for (sg_sampler smp : m_replay_samplers) {
+		if (smp.id != common.smp.id) {
+			sg_destroy_sampler(smp);
+		}
+	}
+
+	m_replay_images.clear();
+	m_replay_samplers.clear();
+	m_has_resources = false;
+}
+
+void FrameCapture::clear() {
+	destroy_resources();
+
+	m_settings = BatcherSettings {};
+	m_complete = false;
+	m_batches.clear();
+	m_commands.clear();
+	m_vertices.clear();
+	m_indices.clear();
+	m_instances.clear();
+	m_uniforms.clear();
+	m_texture_groups.clear();
+	m_pipelines.clear();
+	m_images.clear();
+	m_samplers.clear();
+}
+
+[[nodiscard]] bool FrameCapture::is_complete() const {
+	return m_complete;
+}
+
+[[nodiscard]] const BatcherSettings& FrameCapture::get_settings() const {
+	return m_settings;
+}
+
+void FrameCapture::_record_batch(
+	const RenderBatcher& batcher,
+	u32 command_count,
+	u32 vertex_count,
+	u32 index_count,
+	u32 instance_count
+) {
+	// Arenas only grow within a frame, the last settings fit every batch
+	m_settings = batcher.m_settings;
+
+	usize stride = batcher._vertex_stride();
+	CapturedBatch batch {
+		.command_idx = (u32)m_commands.size(),
+		.command_count = command_count,
+		.vertex_idx = (u32)(m_vertices.size() / stride),
+		.vertex_count = vertex_count,
+		.index_idx = (u32)m_indices.size(),
+		.index_count = index_count,
+		.instance_idx = (u32)m_instances.size(),
+		.instance_count = instance_count,
+		.uniform_idx = (u32)m_uniforms.size(),
+		.uniform_size = batcher.m_cur_uniform,
+		.group_idx = (u32)m_texture_groups.size(),
+		.group_count = (u32)batcher.m_texture_groups.size(),
+	};
+	m_batches.push_back(batch);
+
+	auto commands = std::span(batcher.m_commands).first(command_count);
+	u32 dropped = 0;
+	for (const auto& cmd : commands) {
+		BatchCommand& captured = m_commands.emplace_back(cmd);
+		if (cmd.type != RenderBatcher::BatchCommandType::Draw) {
+			continue;
+		}
+
+		const auto& draw = cmd.args.draw;
+		if (draw.vertex_buf.id != SG_INVALID_ID) {
+			std::memset(&captured, 0, sizeof(BatchCommand)); // Left as merged
+			dropped += 1;
+			continue;
+		}
+
+		_record_pipeline(draw.pipeline);
+		for (const auto& texture : draw.textures) {
+			_record_texture(texture);
+		}
+	}
+
+	if (dropped > 0) {
+		vt::log::warn("[GFX] | FrameCapture > Left out {} retained draws", dropped);
+	}
+
+	const u8 *vertices = batcher._vertex_data();
+	m_vertices.insert(m_vertices.end(), vertices, vertices + vertex_count * stride);
+
+	if (batcher.m_settings.indexed) {
+		auto indices = std::span(batcher.m_indices).first(index_count);
+		m_indices.insert(m_indices.end(), indices.begin(), indices.end());
+	}
+
+	auto instances = std::span(batcher.m_instances).first(instance_count);
+	m_instances.insert(m_instances.end(), instances.begin(), instances.end());
+
+	auto uniforms = std::span(batcher.m_uniform_buffer).first(batcher.m_cur_uniform);
+	m_uniforms.insert(m_uniforms.end(), uniforms.begin(), uniforms.end());
+
+	for (const auto& group : batcher.m_texture_groups) {
+		m_texture_groups.push_back(group);
+		for (const auto& texture : group.textures) {
+			_record_texture(texture);
+		}
+	}
+}
+
+bool FrameCapture::_check_ranges() const {
+	usize stride = _get_vertex_stride(m_settings.vertex_format);
+	if (stride == 0) {
+		return false;
+	}
+
+	u64 vertex_count = m_vertices.size() / stride;
+	for (const auto& batch : m_batches) {
+		bool fits = _fits(batch.command_idx, batch.command_count, m_commands.size())
+				 && _fits(batch.vertex_idx, batch.vertex_count, vertex_count)
+				 && _fits(batch.index_idx, batch.index_count, m_indices.size())
+				 && _fits(batch.instance_idx, batch.instance_count, m_instances.size())
+				 && _fits(batch.uniform_idx, batch.uniform_size, m_uniforms.size())
+				 && _fits(batch.group_idx, batch.group_count, m_texture_groups.size());
+		if (!fits) {
+			return false;
+		}
+
+		// Indices are drawn from the stream buffer, which only holds this batch
+		auto indices = std::span(m_indices).subspan(batch.index_idx, batch.index_count);
+		for (u16 index : indices) {
+			if (index >= batch.vertex_count) {
+				return false;
+			}
+		}
+
+		u32 element_count = m_settings.indexed ? batch.index_count : batch.vertex_count;
+		auto commands = std::span(m_commands)
+							.subspan(batch.command_idx, batch.command_count);
+		for (const auto& cmd : commands) {
+			if (cmd.type > RenderBatcher::BatchCommandType::Draw) {
+				return false;
+			}
+			if (cmd.type != RenderBatcher::BatchCommandType::Draw) {
+				continue;
+			}
+
+			// Retained draws and chained ranges are never recorded
+			const auto& draw = cmd.args.draw;
+			const auto& uniform = draw.uniform;
+			fits = draw.vertex_buf.id == SG_INVALID_ID && draw.index_range == 0
+				&& _fits(draw.element_idx, draw.element_count, element_count)
+				&& _fits(draw.instance_idx, draw.instance_count, batch.instance_count)
+				&& _fits(uniform.offset, uniform.size, batch.uniform_size)
+				&& draw.texture_group <= batch.group_count;
+			if (!fits) {
+				return false;
+			}
+		}
+	}
+
+	return true;
+}
+
+void FrameCapture::_record_pipeline(sg_pipeline pipeline) {
+	for (const auto& captured : m_pipelines) {
+		if (captured.id == pipeline.id) {
+			return;
+		}
+	}
+
+	sg_pipeline_desc desc = sg_query_pipeline_desc(pipeline);
+
+	PipelineKind kind = PipelineKind::Custom;
+	if (desc.shader.id == vt::make_common_shader().id
+		|| desc.shader.id == vt::make_multi_texture_shader().id) {
+		kind = PipelineKind::Batch;
+	} else if (desc.shader.id == vt::make_instanced_shader().id) {
+		kind = PipelineKind::Instanced;
+	}
+
+	// See `init_draw_pass`
+	DrawPass pass = DrawPass::Unsorted;
+	if (desc.depth.write_enabled) {
+		pass = DrawPass::Opaque;
+	} else if (desc.colors[0].blend.enabled) {
+		pass = desc.depth.compare == SG_COMPAREFUNC_LESS_EQUAL ? DrawPass::Translucent
+															   : DrawPass::Blended;
+	}
+
+	m_pipelines.push_back(CapturedPipeline {
+		.id = pipeline.id,
+		.kind = kind,
+		.pass = pass,
+		.primitive = desc.primitive_type,
+		.index_type = desc.index_type,
+	});
+}
+
+void FrameCapture::_record_texture(const Texture& texture) {
+	if (texture.img.id == SG_INVALID_ID) {
+		return;
+	}
+
+	Texture common = make_common_texture();
+
+	auto has_image = [&](const CapturedImage& captured) {
+		return captured.id == texture.img.id;
+	};
+	if (std::none_of(m_images.begin(), m_images.end(), has_image)) {
+		sg_image_desc desc = sg_query_image_desc(texture.img);
+		m_images.push_back(CapturedImage {
+			.id = texture.img.id,
+			.width = desc.width,
+			.height = desc.height,
+			.common = texture.img.id == common.img.id,
+		});
+	}
+
+	auto has_sampler = [&](const CapturedSampler& captured) {
+		return captured.id == texture.smp.id;
+	};
+	if (texture.smp.id != SG_INVALID_ID
+		&& std::none_of(m_samplers.begin(), m_samplers.end(), has_sampler)) {
+		sg_sampler_desc desc = sg_query_sampler_desc(texture.smp);
+		desc.label = nullptr;
+		m_samplers.push_back(CapturedSampler {
+			.id = texture.smp.id,
+			.desc = desc,
+			.common = texture.smp.id == common.smp.id,
+		});
+	}
+}
+
+void FrameCapture::_remap_texture(Texture& texture) const {
+	if (texture.img.id == SG_INVALID_ID) {
+		return;
+	}
+
+	for (u32 i = 0; i < m_images.size(); i += 1) {
+		if (m_images[i].id == texture.img.id) {
+			texture.img = m_replay_images[i];
+			break;
+		}
+	}
+
+	for (u32 i = 0; i < m_samplers.size(); i += 1) {
+		if (m_samplers[i].id == texture.smp.id) {
+			texture.smp = m_replay_samplers[i];
+			break;
+		}
+	}
+}
@@ -0,0 +1,163 @@
+#include "gfx/Layer.hpp"
+
+#include "gfx/RenderBatcher.hpp"
+#include "log.hpp"
+
+#include <algorithm>
+
+using namespace vt;
+
+void Layer::add(const Drawable& drawable) {
+	m_items.push_back(LayerItem { &drawable, drawable.get_revision() });
+	m_dirty = true;
+}
+
+void Layer::remove(const Drawable& drawable) {
+	auto it = std::find_if(m_items.begin(), m_items.end(), [&](const LayerItem& item) {
+		return item.drawable == &drawable;
+	});
+
+	if (it == m_items.end()) {
+		return;
+	}
+
+	m_items.erase(it);
+	m_dirty = true;
+}
+
+void Layer::clear() {
+	m_items.clear();
+	m_dirty = true;
+}
+
+void Layer::set_size(Point size) {
+	if (m_size == size) {
+		return;
+	}
+
+	m_size = size;
+	m_dirty = true;
+}
+
+void Layer::invalidate() {
+	m_dirty = true;
+}
+
+bool Layer::update(RenderBatcher& batcher, RenderTargetPool& pool) {
+	if (m_size.w <= 0 || m_size.h <= 0) {
+		return false;
+	}
+
+	// Resized targets are swapped for one of the new size
+	if (m_target.is_valid() && m_target.get_size() != m_size) {
+		release(pool);
+	}
+
+	if (!m_target.is_valid()) {
+		// Depth is kept, builtin pipelines expect the environment's one
+		RenderTargetDesc desc {};
+		desc.width = m_size.w;
+		desc.height = m_size.h;
+
+		m_target = pool.acquire(desc);
+		if (!m_target.is_valid()) {
+			vt::log::error("[GFX] | Layer > Failed to acquire a render target");
+			return false;
+		}
+
+		_make_quad();
+		m_dirty = true;
+	}
+
+	if (!is_dirty()) {
+		return false;
+	}
+
+	batcher.flush();
+
+	// Cleared in a pass of its own, the batcher doesn't begin one when nothing
+	// is visible
+	sg_pass clear_pass {};
+	clear_pass.attachments = m_target.get_attachments();
+	clear_pass.action.colors[0].load_action = SG_LOADACTION_CLEAR;
+	clear_pass.action.colors[0].clear_value = { 0.0, 0.0, 0.0, 0.0 };
+	clear_pass.action.depth.load_action = SG_LOADACTION_CLEAR;
+	clear_pass.action.depth.clear_value = 1.0;
+	sg_begin_pass(&clear_pass);
+	sg_end_pass();
+
+	sg_pass_action action = batcher.get_pass_action();
+	sg_pass_action load_action {};
+	load_action.colors[0].load_action = SG_LOADACTION_LOAD;
+	load_action.depth.load_action = SG_LOADACTION_LOAD;
+	batcher.set_pass_action(load_action);
+	batcher.set_target(m_target);
+
+	for (auto& item : m_items) {
+		batcher.draw(*item.drawable);
+		item.revision = item.drawable->get_revision();
+	}
+
+	batcher.flush();
+	batcher.set_pass_action(action);
+
+	m_dirty = false;
+	return true;
+}
+
+void Layer::draw(RenderBatcher& batcher) {
+	if (!m_target.is_valid()) {
+		return;
+	}
+
+	// Blended over what's below, transparent parts of the target included
+	const BatcherSettings& settings = batcher.get_settings();
+	sg_pipeline pipeline = vt::make_pipeline(
+		SG_PRIMITIVETYPE_TRIANGLES,
+		settings.indexed ? SG_INDEXTYPE_UINT16 : SG_INDEXTYPE_NONE,
+		settings.vertex_format, DrawPass::Blended
+	);
+
+	(Transform&)m_quad = *this;
+	batcher.apply_pipeline(pipeline);
+	batcher.draw(m_quad);
+	batcher.apply_pipeline(sg_pipeline { SG_INVALID_ID });
+}
+
+void Layer::release(RenderTargetPool& pool) {
+	if (!m_target.is_valid()) {
+		return;
+	}
+
+	pool.release(m_target);
+	m_target = RenderTarget {};
+}
+
+[[nodiscard]] bool Layer::is_dirty() const {
+	if (m_dirty) {
+		return true;
+	}
+
+	return std::any_of(m_items.begin(), m_items.end(), [](const LayerItem& item) {
+		return item.drawable->get_revision() != item.revision;
+	});
+}
+
+void Layer::_make_quad() {
+	f32 w = m_size.w;
+	f32 h = m_size.h;
+
+	// Render targets are upside down where textures start at the bottom
+	f32 top = sg_query_features().origin_top_left ? 0.0 : 1.0;
+	f32 bottom = 1.0 - top;
+
+	Vertex vertices[4] = {
+		Vertex(Vec3(0.0, 0.0, 0.0), Vec2(0.0, top)),	// Top Left
+		Vertex(Vec3(w, 0.0, 0.0), Vec2(1.0, top)),		// Top Right
+		Vertex(Vec3(w, h, 0.0), Vec2(1.0, bottom)),	// Bottom Right
+		Vertex(Vec3(0.0, h, 0.0), Vec2(0.0, bottom)), // Bottom Left
+	};
+
+	m_quad = Drawable { SG_PRIMITIVETYPE_TRIANGLES, vertices, QUAD_INDICES };
+	m_quad.set_texture(0, m_target.get_texture());
+}
@@ -0,0 +1,290 @@
+#include "gfx/ProgramCache.hpp"
+
+#include "log.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <format>
+#include <vector>
+
+#if !VT_GFX_DUMMY_BACKEND
+#	include <glad/gl.h>
+#endif
+
+using namespace vt;
+
+static program_cache::Stats s_stats {};
+
+#if !VT_GFX_DUMMY_BACKEND
+
+struct BinaryHeader {
+	u32 magic;
+	u32 version;
+	u64 key;
+	u32 format; // Driver specific, one of `GL_PROGRAM_BINARY_FORMATS`
+	u32 size;
+};
+
+static constexpr u32 _MAGIC = 0x42505456; // "VTPB"
+static constexpr u32 _VERSION = 1;
+
+static std::string s_dir;
+static std::vector<GLint> s_formats;
+static u64 s_driver_key {};
+static bool s_enabled {};
+
+// sokol compiles and links programs itself, so while it makes a shader whose
+// binary is cached the glad entry points it calls are swapped: compiling does
+// nothing and linking loads the binary instead
+static const std::vector<u8> *s_binary {};
+static GLenum s_binary_format {};
+
+static PFNGLSHADERSOURCEPROC s_shader_source {};
+static PFNGLCOMPILESHADERPROC s_compile_shader {};
+static PFNGLGETSHADERIVPROC s_get_shader_iv {};
+static PFNGLLINKPROGRAMPROC s_link_program {};
+
+static void GLAD_API_PTR _skip_shader_source(
+	GLuint, GLsizei, const GLchar *const *, const GLint *
+) { }
+
+static void GLAD_API_PTR _skip_compile_shader(GLuint) { }
+
+static void GLAD_API_PTR _get_skipped_shader_iv(
+	GLuint shader, GLenum pname, GLint *params
+) {
+	if (pname == GL_COMPILE_STATUS) {
+		*params = GL_TRUE;
+		return;
+	}
+
+	s_get_shader_iv(shader, pname, params);
+}
+
+static void GLAD_API_PTR _load_binary(GLuint program) {
+	// sokol checks the link status next, which tells if the driver took it
+	glProgramBinary(program, s_binary_format, s_binary->data(), s_binary->size());
+}
+
+static void GLAD_API_PTR _link_retrievable(GLuint program) {
+	glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+	s_link_program(program);
+}
+
+static u64 _hash(u64 hash, const char *str) {
+	// FNV-1a, terminators included so strings can't run into each other
+	for (const char *c = str ? str : "";; c += 1) {
+		hash = (hash ^ (u8)*c) * 1099511628211ull;
+		if (*c == '\0') {
+			return hash;
+		}
+	}
+}
+
+static std::string _get_path(u64 key) {
+	return std::format("{}/{:016x}.glprog", s_dir, key);
+}
+
+static u64 _get_bytes_left(std::FILE *file) {
+	long pos = std::ftell(file);
+	if (pos < 0 || std::fseek(file, 0, SEEK_END) != 0) {
+		return 0;
+	}
+
+	long end = std::ftell(file);
+	if (std::fseek(file, pos, SEEK_SET) != 0 || end < pos) {
+		return 0;
+	}
+
+	return end - pos;
+}
+
+static bool _read_binary(u64 key, GLenum& format, std::vector<u8>& binary) {
+	std::FILE *file = std::fopen(_get_path(key).c_str(), "rb");
+	if (!file) {
+		return false;
+	}
+
+	// Formats the driver doesn't list are an error rather than a failed link
+	BinaryHeader header {};
+	bool read = std::fread(&header, sizeof(BinaryHeader), 1, file) == 1
+			 && header.magic == _MAGIC && header.version == _VERSION
+			 && header.key == key && header.size > 0
+			 && header.size <= _get_bytes_left(file)
+			 && std::find(s_formats.begin(), s_formats.end(), (GLint)header.format)
+					!= s_formats.end();
+
+	if (read) {
+		binary.resize(header.size);
+		read = std::fread(binary.data(), 1, header.size, file) == header.size;
+	}
+
+	std::fclose(file);
+	format = header.format;
+	return read;
+}
+
+static void _write_binary(u64 key, sg_shader shdr) {
+	GLuint prog = sg_gl_query_shader_info(shdr).prog;
+	GLint size = 0;
+	glGetProgramiv(prog, GL_PROGRAM_BINARY_LENGTH, &size);
+	if (size <= 0) {
+		return;
+	}
+
+	std::vector<u8> binary(size);
+	GLenum format = 0;
+	glGetProgramBinary(prog, size, &size, &format, binary.data());
+	if (size <= 0) {
+		return;
+	}
+
+	// Written aside then renamed, an interrupted write never leaves a binary cut
+	// short under the real name
+	std::string path = _get_path(key);
+	std::string tmp_path = path + ".tmp";
+	std::FILE *file = std::fopen(tmp_path.c_str(), "wb");
+	if (!file) {
+		vt::log::warn("[GFX] | ProgramCache > Failed to open '{}'", tmp_path);
+		return;
+	}
+
+	BinaryHeader header {
+		.magic = _MAGIC,
+		.version = _VERSION,
+		.key = key,
+		.format = format,
+		.size = (u32)size,
+	};
+
+	bool written = std::fwrite(&header, sizeof(BinaryHeader), 1, file) == 1
+				&& std::fwrite(binary.data(), 1, size, file) == (usize)size;
+	written = std::fclose(file) == 0 && written;
+
+	if (!written || std::rename(tmp_path.c_str(), path.c_str()) != 0) {
+		vt::log::warn("[GFX] | ProgramCache > Failed to write '{}'", path);
+		std::remove(tmp_path.c_str());
+	}
+}
+
+static void _init_from_binary(
+	sg_shader shdr,
+	const sg_shader_desc& desc,
+	GLenum format,
+	const std::vector<u8>& binary
+) {
+	s_binary = &binary;
+	s_binary_format = format;
+
+	glad_glShaderSource = _skip_shader_source;
+	glad_glCompileShader = _skip_compile_shader;
+	glad_glGetShaderiv = _get_skipped_shader_iv;
+	glad_glLinkProgram = _load_binary;
+
+	sg_init_shader(shdr, &desc);
+
+	glad_glShaderSource = s_shader_source;
+	glad_glCompileShader = s_compile_shader;
+	glad_glGetShaderiv = s_get_shader_iv;
+	glad_glLinkProgram = s_link_program;
+
+	s_binary = nullptr;
+}
+
+static void _init_retrievable(sg_shader shdr, const sg_shader_desc& desc) {
+	glad_glLinkProgram = _link_retrievable;
+	sg_init_shader(shdr, &desc);
+	glad_glLinkProgram = s_link_program;
+}
+
+#endif
+
+bool program_cache::init([[maybe_unused]] const std::string& dir) {
+#if !VT_GFX_DUMMY_BACKEND
+	// Program binaries are core since GL 4.1, some drivers still list no format
+	GLint count = 0;
+	if (GLAD_GL_VERSION_4_1) {
+		glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &count);
+	}
+
+	if (count <= 0) {
+		vt::log::warn("[GFX] | ProgramCache > The driver has no program binary format");
+		return false;
+	}
+
+	s_formats.resize(count);
+	glGetIntegerv(GL_PROGRAM_BINARY_FORMATS, s_formats.data());
+
+	// Binaries only load on the driver that made them
+	s_driver_key = 14695981039346656037ull;
+	for (GLenum name : { GL_VENDOR, GL_RENDERER, GL_VERSION }) {
+		s_driver_key = _hash(s_driver_key, (const char *)glGetString(name));
+	}
+
+	s_shader_source = glad_glShaderSource;
+	s_compile_shader = glad_glCompileShader;
+	s_get_shader_iv = glad_glGetShaderiv;
+	s_link_program = glad_glLinkProgram;
+
+	s_dir = dir;
+	s_enabled = true;
+#endif
+	return true;
+}
+
+void program_cache::terminate() {
+#if !VT_GFX_DUMMY_BACKEND
+	s_enabled = false;
+	s_dir.clear();
+	s_formats.clear();
+#endif
+}
+
+sg_shader program_cache::make_shader(const sg_shader_desc& desc) {
+	sg_shader shdr = sg_alloc_shader();
+	if (shdr.id == SG_INVALID_ID) {
+		return shdr;
+	}
+
+	init_shader(shdr, desc);
+	return shdr;
+}
+
+void program_cache::init_shader(sg_shader shdr, const sg_shader_desc& desc) {
+#if !VT_GFX_DUMMY_BACKEND
+	// Compute shaders aren't cached
+	if (s_enabled && desc.vertex_func.source && desc.fragment_func.source) {
+		u64 key = _hash(
+			_hash(s_driver_key, desc.vertex_func.source), desc.fragment_func.source
+		);
+
+		GLenum format = 0;
+		std::vector<u8> binary;
+		if (_read_binary(key, format, binary)) {
+			_init_from_binary(shdr, desc, format, binary);
+			if (sg_query_shader_state(shdr) == SG_RESOURCESTATE_VALID) {
+				s_stats.hits += 1;
+				return;
+			}
+
+			// Drivers may refuse binaries of another build with the same version
+			vt::log::warn("[GFX] | ProgramCache > Cached binary rejected, compiling");
+			s_stats.rejected += 1;
+			sg_uninit_shader(shdr);
+		}
+
+		_init_retrievable(shdr, desc);
+		if (sg_query_shader_state(shdr) == SG_RESOURCESTATE_VALID) {
+			s_stats.misses += 1;
+			_write_binary(key, shdr);
+		}
+		return;
+	}
+#endif
+
+	sg_init_shader(shdr, &desc);
+}
+
+[[nodiscard]] program_cache::Stats program_cache::get_stats() {
+	return s_stats;
+}
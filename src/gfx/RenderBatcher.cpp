@@ -2,25 +2,148 @@
 
 #include "core/Window.hpp"
 #include "gfx/Drawable.hpp"
+#include "gfx/FrameCapture.hpp"
+#include "gfx/RenderTarget.hpp"
+#include "gfx/StaticBatch.hpp"
+#include "gfx/kernels.hpp"
 #include "log.hpp"
 
+#include <algorithm>
 #include <cstring>
+#include <utility>
 
 using namespace vt;
 
-bool RenderBatcher::init(u32 max_vertices, u32 max_commands) {
-	m_vertices.resize(max_vertices > 0 ? max_vertices : _DEFAULT_MAX_VERTICES);
-	m_commands.resize(max_commands > 0 ? max_commands : _DEFAULT_MAX_COMMANDS);
+template <typename Fn>
+decltype(auto) RenderBatcher::_visit_vertices(Fn&& fn) {
+	switch (m_settings.vertex_format) {
+	case VertexFormat::Compact:
+		return fn(m_compact_vertices);
+	case VertexFormat::MultiTexture:
+		return fn(m_multi_vertices);
+	default:
+		return fn(m_vertices);
+	}
+}
 
-	sg_buffer_desc bufdesc {};
-	bufdesc.size = m_vertices.capacity() * sizeof(Vertex);
-	bufdesc.usage.vertex_buffer = true;
-	bufdesc.usage.stream_update = true;
-	bufdesc.label = "vt_render_batcher.vertex_buffer";
+template <typename Fn>
+decltype(auto) RenderBatcher::_visit_vertices(Fn&& fn) const {
+	switch (m_settings.vertex_format) {
+	case VertexFormat::Compact:
+		return fn(m_compact_vertices);
+	case VertexFormat::MultiTexture:
+		return fn(m_multi_vertices);
+	default:
+		return fn(m_vertices);
+	}
+}
 
-	m_vertex_buf = sg_make_buffer(bufdesc);
-	if (sg_query_buffer_state(m_vertex_buf) != SG_RESOURCESTATE_VALID) {
-		vt::log::error("[GFX] | RenderBatcher > Failed to make vertex buffer handler");
+bool RenderBatcher::init(const BatcherSettings& settings) {
+	m_settings = settings;
+	if (m_settings.max_vertices == 0) {
+		m_settings.max_vertices = _DEFAULT_MAX_VERTICES;
+	}
+	if (m_settings.max_commands == 0) {
+		m_settings.max_commands = _DEFAULT_MAX_COMMANDS;
+	}
+	if (m_settings.max_commands < _DRAW_COMMANDS) {
+		vt::log::warn(
+			"[GFX] | RenderBatcher > Raising max commands to {}", _DRAW_COMMANDS
+		);
+		m_settings.max_commands = _DRAW_COMMANDS;
+	}
+	if (m_settings.max_instances == 0) {
+		m_settings.max_instances = _DEFAULT_MAX_INSTANCES;
+	}
+	if (m_settings.max_indices == 0) {
+		m_settings.max_indices = m_settings.max_vertices / 4 * 6;
+	}
+	if (m_settings.buffer_count == 0) {
+		m_settings.buffer_count = _DEFAULT_BUFFER_COUNT;
+	}
+	if (m_settings.buffer_count > _MAX_BUFFER_COUNT) {
+		vt::log::warn(
+			"[GFX] | RenderBatcher > Clamping buffer ring to {} buffers",
+			_MAX_BUFFER_COUNT
+		);
+		m_settings.buffer_count = _MAX_BUFFER_COUNT;
+	}
+	if (m_settings.buffer_count == 1) {
+		vt::log::warn("[GFX] | RenderBatcher > A single buffer is rewritten every frame");
+	}
+
+	// Opaque and translucent draws are separated by the sort
+	if (m_settings.depth_sorted && !m_settings.deferred) {
+		vt::log::warn("[GFX] | RenderBatcher > Depth sorted mode requires deferred mode");
+		m_settings.deferred = true;
+	}
+
+	// Compact vertices have no depth to test
+	if (m_settings.depth_sorted && m_settings.vertex_format == VertexFormat::Compact) {
+		vt::log::warn(
+			"[GFX] | RenderBatcher > Depth sorted mode requires standard vertices"
+		);
+		m_settings.vertex_format = VertexFormat::Standard;
+	}
+
+	// Sorted draws are concatenated through the index buffer
+	if (m_settings.deferred && !m_settings.indexed) {
+		vt::log::warn("[GFX] | RenderBatcher > Deferred mode requires indexed mode");
+		m_settings.indexed = true;
+	}
+
+	// So are chained ranges
+	if (m_settings.indirect_merge && !m_settings.indexed) {
+		vt::log::warn(
+			"[GFX] | RenderBatcher > Indirect merge mode requires indexed mode"
+		);
+		m_settings.indexed = true;
+	}
+
+	// Sorting already merges every draw, nothing is chained
+	if (m_settings.deferred) {
+		m_settings.indirect_merge = false;
+	}
+
+	// Indices are absolute within a flush, so every vertex must fit in an u16
+	if (m_settings.indexed && m_settings.max_vertices > _MAX_INDEXED_VERTICES) {
+		vt::log::warn(
+			"[GFX] | RenderBatcher > Clamping max vertices to {} in indexed mode",
+			_MAX_INDEXED_VERTICES
+		);
+		m_settings.max_vertices = _MAX_INDEXED_VERTICES;
+	}
+
+	_visit_vertices([&](auto& arena) { arena.resize(m_settings.max_vertices); });
+	m_commands.resize(m_settings.max_commands);
+	m_instances.resize(m_settings.max_instances);
+	m_uniform_buffer.resize(_UNIFORM_BUFFER_SIZE);
+	m_contexts.resize(m_settings.context_count);
+	if (m_settings.vertex_format == VertexFormat::MultiTexture) {
+		m_texture_groups.reserve(_DEFAULT_TEXTURE_GROUPS);
+	}
+	if (m_settings.indexed) {
+		m_indices.resize(m_settings.max_indices);
+	}
+	if (m_settings.deferred) {
+		m_sort_entries.resize(m_settings.max_commands);
+		m_sort_scratch.resize(m_settings.max_commands);
+		m_sorted_commands.resize(m_settings.max_commands);
+	}
+	if (m_settings.deferred || m_settings.indirect_merge) {
+		m_sorted_indices.resize(m_settings.max_indices);
+	}
+	if (m_settings.indirect_merge) {
+		m_index_ranges.reserve(m_settings.max_commands);
+	}
+
+	if (!_make_stream_buffers()) {
+		return false;
+	}
+
+	// Frame boundaries are only known by sokol
+	if (!sg_add_commit_listener({ _commit_listener, this })) {
+		vt::log::error("[GFX] | RenderBatcher > Failed to add commit listener");
 		return false;
 	}
 
@@ -29,9 +152,10 @@ bool RenderBatcher::init(u32 max_vertices, u32 max_commands) {
 }
 
 void RenderBatcher::terminate() {
-	if (sg_query_buffer_state(m_vertex_buf) != SG_RESOURCESTATE_INVALID) {
-		sg_destroy_buffer(m_vertex_buf);
-	}
+	sg_remove_commit_listener({ _commit_listener, this });
+	_destroy_stream_buffers();
+
+	m_is_valid = false;
 }
 
 void RenderBatcher::draw(const Drawable& drawable) {
@@ -41,70 +165,204 @@ void RenderBatcher::draw(const Drawable& drawable) {
 		return;
 	}
 
-	u32 vertex_idx = m_cur_vertex;
-	u32 vertex_count = drawable.m_vertices.size();
-	auto vertices = _get_vertices(vertex_count);
-	if (vertices.empty()) {
-		return;
-	}
-
 	const Mat4& model = drawable.get_matrix();
 	const Mat4& view = m_state.view.get_transform();
 	Mat4 mvp = m_state.proj * view * model;
 
-	Rect region { FLT_MAX, FLT_MAX, -FLT_MAX, -FLT_MAX };
+	// Reject off-screen drawables before any vertex is written
+	if (!drawable._is_visible(mvp, m_state.clip)) {
+		return;
+	}
+
+	const auto& local_indices = drawable.m_indices;
+
+	// Without an index buffer, indexed drawables are expanded back into a plain
+	// vertex list
+	bool expand = !m_settings.indexed && !local_indices.empty();
+
+	u32 vertex_count = expand ? local_indices.size() : drawable.m_vertices.size();
+	u32 index_count = 0;
+	if (m_settings.indexed) {
+		index_count = local_indices.empty() ? vertex_count : local_indices.size();
+	}
+
+	_reserve(vertex_count, index_count);
+
+	DrawCommand draw {};
+
+	u32 vertex_idx = m_cur_vertex;
+	bool emitted = _visit_vertices([&](auto& arena) {
+		auto vertices = _get_vertices(arena, vertex_count);
+		if (vertices.empty()) {
+			return false;
+		}
 
-	for (u32 i = 0; i < vertex_count; i += 1) {
-		const auto& vertex = drawable.m_vertices[i];
+		draw.region = drawable._emit_vertices(mvp, expand, vertices);
+		return true;
+	});
+	if (!emitted) {
+		return;
+	}
 
-		Vec3 position = mvp * vertex.position;
-		vertices[i].position = position;
-		vertices[i].color = vertex.color;
-		vertices[i].texcoord = vertex.texcoord;
+	u32 index_idx = m_cur_index;
+	if (m_settings.indexed) {
+		auto indices = _get_indices(index_count);
+		if (indices.empty()) {
+			m_cur_vertex -= vertex_count; // Rewind vertices
+			return;
+		}
 
-		// Update region area the rendering takes
-		region.x1 = std::min(region.x1, vertices[i].position.x);
-		region.y1 = std::min(region.y1, vertices[i].position.y);
-		region.x2 = std::max(region.x2, vertices[i].position.x);
-		region.y2 = std::max(region.y2, vertices[i].position.y);
+		drawable._emit_indices(vertex_idx, indices);
 	}
 
-	DrawCommand draw;
-	draw.region = region;
 	draw.textures = drawable.m_textures;
-	draw.vertex_idx = vertex_idx;
-	draw.vertex_count = vertex_count;
+	draw.pipeline = m_state.pipeline;
+	draw.uniform = m_state.uniform;
+	draw.element_idx = m_settings.indexed ? index_idx : vertex_idx;
+	draw.element_count = m_settings.indexed ? index_count : vertex_count;
+	_assign_texture_slot(draw, vertex_idx, vertex_count);
+
+	DrawOrder order = _make_draw_order(drawable._get_depth(mvp));
+	_submit_draw(draw, drawable.m_primitive, order, vertex_count, index_count);
+}
 
-	// Override pipeline if state has set one
-	if (m_state.pipeline.id != SG_INVALID_ID) {
-		draw.pipeline = m_state.pipeline;
-		draw.uniform = m_state.uniform;
-	} else {
-		draw.pipeline = vt::make_pipeline(drawable.m_primitive);
-		draw.uniform = UniformBuffer {};
+void RenderBatcher::draw_instanced(
+	const Drawable& mesh, std::span<const SpriteInstance> instances
+) {
+	assert(m_is_valid);
+
+	if (mesh.m_vertices.empty() || instances.empty()) {
+		return;
 	}
 
-	if (sg_query_pipeline_state(draw.pipeline) != SG_RESOURCESTATE_VALID) {
-		m_cur_vertex -= vertex_count; // Rewind vertices
+	sg_index_type index_type = m_settings.indexed ? SG_INDEXTYPE_UINT16
+												  : SG_INDEXTYPE_NONE;
+	sg_pipeline pipeline = vt::make_instanced_pipeline(
+		mesh.m_primitive,
+		index_type,
+		m_settings.vertex_format,
+		_get_draw_pass(m_state.translucent)
+	);
+	if (sg_query_pipeline_state(pipeline) != SG_RESOURCESTATE_VALID) {
 		return;
 	}
 
-	// Try to merge command with any previous command
-	if (drawable.m_primitive != SG_PRIMITIVETYPE_LINE_STRIP
-		&& drawable.m_primitive != SG_PRIMITIVETYPE_TRIANGLE_STRIP
-		&& _try_merge_command(draw)) {
-		return; // Succefully merged
+	const auto& local_indices = mesh.m_indices;
+	bool expand = !m_settings.indexed && !local_indices.empty();
+
+	u32 vertex_count = expand ? local_indices.size() : mesh.m_vertices.size();
+	u32 index_count = 0;
+	if (m_settings.indexed) {
+		index_count = local_indices.empty() ? vertex_count : local_indices.size();
 	}
 
-	BatchCommand *cmd = _next_command();
-	if (!cmd) {
+	_reserve(vertex_count, index_count, instances.size());
+
+	u32 vertex_idx = m_cur_vertex;
+	bool copied = _visit_vertices([&](auto& arena) {
+		auto vertices = _get_vertices(arena, vertex_count);
+		if (vertices.empty()) {
+			return false;
+		}
+
+		// Vertices are uploaded in the mesh space, the GPU applies the transforms
+		using V = typename std::decay_t<decltype(arena)>::value_type;
+		for (u32 i = 0; i < vertex_count; i += 1) {
+			vertices[i] = V { mesh.m_vertices[expand ? local_indices[i] : i] };
+		}
+		return true;
+	});
+	if (!copied) {
+		return;
+	}
+
+	u32 index_idx = m_cur_index;
+	if (m_settings.indexed) {
+		auto indices = _get_indices(index_count);
+		if (indices.empty()) {
+			m_cur_vertex -= vertex_count; // Rewind vertices
+			return;
+		}
+
+		mesh._emit_indices(vertex_idx, indices);
+	}
+
+	u32 instance_idx = m_cur_instance;
+	auto instances_out = _get_instances(instances.size());
+	if (instances_out.empty()) {
 		m_cur_vertex -= vertex_count; // Rewind vertices
+		m_cur_index -= index_count;
 		return;
 	}
 
-	std::memset(cmd, 0, sizeof(BatchCommand));
-	cmd->type = BatchCommandType::Draw;
-	cmd->args.draw = draw;
+	std::copy(instances.begin(), instances.end(), instances_out.begin());
+
+	const Mat4& model = mesh.get_matrix();
+	const Mat4& view = m_state.view.get_transform();
+	Mat4 mvp = m_state.proj * view * model;
+
+	UniformBuffer uniform = _push_uniform(std::span((const u8 *)&mvp, sizeof(Mat4)));
+
+	DrawCommand draw {};
+	// Instances may land anywhere, so treat the draw as covering the whole
+	// target rather than transforming every instance on the CPU
+	draw.region = Rect { -1.0, -1.0, 1.0, 1.0 };
+	draw.textures = mesh.m_textures;
+	draw.pipeline = pipeline;
+	draw.uniform = uniform;
+	draw.element_idx = m_settings.indexed ? index_idx : vertex_idx;
+	draw.element_count = m_settings.indexed ? index_count : vertex_count;
+	draw.instance_idx = instance_idx;
+	draw.instance_count = instances.size();
+
+	DrawOrder order = _make_draw_order(mesh._get_depth(mvp));
+	_submit_draw(draw, mesh.m_primitive, order, vertex_count, index_count);
+}
+
+void RenderBatcher::draw(const StaticBatch& batch) {
+	assert(m_is_valid);
+	assert(batch.is_baked());
+
+	const Mat4& view = m_state.view.get_transform();
+	Mat4 view_proj = m_state.proj * view;
+
+	UniformBuffer uniform = _push_uniform(
+		std::span((const u8 *)&view_proj, sizeof(Mat4))
+	);
+
+	for (const auto& baked : batch.m_commands) {
+		Rect region = kernels::transform_rect(view_proj, baked.bounds);
+		if (!region.intersects(m_state.clip, true)) {
+			continue;
+		}
+
+		_reserve(0, 0);
+
+		DrawCommand draw {};
+		draw.region = region;
+		draw.textures = baked.textures;
+		draw.pipeline = baked.pipeline;
+		draw.uniform = uniform;
+		draw.element_idx = baked.index_idx;
+		draw.element_count = baked.index_count;
+		draw.vertex_buf = batch.m_vertex_buf;
+		draw.index_buf = batch.m_index_buf;
+
+		if (m_settings.depth_sorted) {
+			DrawPass pass = _get_draw_pass(m_state.translucent);
+			draw.pipeline = vt::make_static_pipeline(baked.primitive, pass);
+		}
+
+		// Baked vertices are sorted as if they all lied on the world plane
+		Vec3 center {
+			(baked.bounds.x1 + baked.bounds.x2) * 0.5f,
+			(baked.bounds.y1 + baked.bounds.y2) * 0.5f,
+			0.0,
+		};
+		DrawOrder order = _make_draw_order((view_proj * center).z);
+
+		_submit_draw(draw, baked.primitive, order, 0, 0);
+	}
 }
 
 void RenderBatcher::set_target(const Window& window) {
@@ -130,8 +388,52 @@ void RenderBatcher::set_target(const sg_attachments& attachments) {
 	assert(m_is_valid);
 	assert(attachments.id != SG_INVALID_ID);
 
-	m_cur_pass.attachments = attachments;
-	m_cur_pass.swapchain = sg_swapchain {};
+	// Frame size is taken from the first color attachment
+	sg_attachments_desc desc = sg_query_attachments_desc(attachments);
+	sg_image_desc image = sg_query_image_desc(desc.colors[0].image);
+	_set_offscreen_target(attachments, Point { image.width, image.height });
+}
+
+void RenderBatcher::set_target(const RenderTarget& target) {
+	assert(m_is_valid);
+	assert(target.is_valid());
+
+	_set_offscreen_target(target.get_attachments(), target.get_size());
+}
+
+void RenderBatcher::set_pass_action(const sg_pass_action& action) {
+	assert(m_is_valid);
+
+	// A pass resumed after an overflow keeps loading what it drew so far, the
+	// action is restored by the next flush
+	if (m_pass_resumed) {
+		m_pass_action = action;
+		return;
+	}
+
+	m_cur_pass.action = action;
+}
+
+[[nodiscard]] const sg_pass_action& RenderBatcher::get_pass_action() const {
+	return m_pass_resumed ? m_pass_action : m_cur_pass.action;
+}
+
+BatchContext& RenderBatcher::get_context(u32 slot) {
+	assert(m_is_valid);
+	assert(slot < m_contexts.size());
+
+	BatchContext& context = m_contexts[slot];
+	context.m_state = m_state;
+	context.m_indexed = m_settings.indexed;
+
+	return context;
+}
+
+void RenderBatcher::apply_pipeline(sg_pipeline pipeline, std::span<const u8> uniforms) {
+	assert(m_is_valid);
+
+	m_state.pipeline = pipeline;
+	m_state.uniform = _push_uniform(uniforms);
 }
 
 void RenderBatcher::apply_view(const View& view) {
@@ -149,6 +451,8 @@ void RenderBatcher::apply_viewport(f32 x, f32 y, f32 w, f32 h) {
 		return;
 	}
 
+	_reserve(0, 0);
+
 	// Try to reuse previous command
 	auto *cmd = _prev_command(1);
 	if (!cmd || cmd->type != BatchCommandType::Viewport) {
@@ -162,6 +466,8 @@ void RenderBatcher::apply_viewport(f32 x, f32 y, f32 w, f32 h) {
 	cmd->type = BatchCommandType::Viewport;
 	cmd->args.viewport = viewport;
 
+	_split_draws(); // Draws are never sorted or merged across viewport changes
+
 	// Adjust state scissor offset relative to the new viewport
 	if (m_state.scissor.w > 0 && m_state.scissor.h > 0) {
 		m_state.scissor.x += viewport.x - m_state.viewport.x;
@@ -172,6 +478,7 @@ void RenderBatcher::apply_viewport(f32 x, f32 y, f32 w, f32 h) {
 
 	// Reset projection
 	m_state.proj = Mat4::ortho(0.0, viewport.w, viewport.h, 0.0);
+	_update_clip();
 }
 
 void RenderBatcher::apply_scissor(f32 x, f32 y, f32 w, f32 h) {
@@ -184,6 +491,8 @@ void RenderBatcher::apply_scissor(f32 x, f32 y, f32 w, f32 h) {
 		return;
 	}
 
+	_reserve(0, 0);
+
 	// Try to reuse previous command
 	auto *cmd = _prev_command(1);
 	if (!cmd || cmd->type != BatchCommandType::Scissor) {
@@ -206,7 +515,20 @@ void RenderBatcher::apply_scissor(f32 x, f32 y, f32 w, f32 h) {
 	cmd->type = BatchCommandType::Scissor;
 	cmd->args.scissor = scissor;
 
+	_split_draws(); // Draws are never sorted or merged across scissor changes
+
 	m_state.scissor = scissor;
+	_update_clip();
+}
+
+void RenderBatcher::apply_layer(u8 layer) {
+	assert(m_is_valid);
+	m_state.layer = layer;
+}
+
+void RenderBatcher::apply_translucent(bool translucent) {
+	assert(m_is_valid);
+	m_state.translucent = translucent;
 }
 
 void RenderBatcher::reset() {
@@ -214,6 +536,8 @@ void RenderBatcher::reset() {
 	m_state.proj = Mat4::ortho(0.0, m_state.framesize.w, m_state.framesize.h, 0.0);
 	m_state.pipeline.id = SG_INVALID_ID;
 	m_state.uniform = UniformBuffer {};
+	m_state.layer = 0;
+	m_state.translucent = false;
 
 	apply_viewport(0.0, 0.0, m_state.framesize.w, m_state.framesize.h);
 	apply_scissor(0.0, 0.0, -1.0, -1.0);
@@ -222,27 +546,231 @@ void RenderBatcher::reset() {
 void RenderBatcher::flush() {
 	assert(m_is_valid);
 
+	_stitch_contexts();
+	bool submitted = _submit();
+	m_texture_groups.clear();
+
+	// Uniforms live for the whole frame, overflow flushes keep referencing them
+	m_cur_uniform = 0;
+	m_uniform_cache.fill(UniformSlot {});
+
+	// Next pass starts with the user's actions again
+	_restore_pass();
+
+	if (submitted) {
+		reset();
+	}
+}
+
+void RenderBatcher::capture_frame(FrameCapture& capture) {
+	assert(m_is_valid);
+
+	capture.clear();
+	m_capture_next = &capture;
+}
+
+bool RenderBatcher::replay(const FrameCapture& capture) {
+	assert(m_is_valid);
+	assert(capture.m_has_resources);
+
+	const BatcherSettings& settings = capture.m_settings;
+	if (settings.vertex_format != m_settings.vertex_format
+		|| settings.indexed != m_settings.indexed
+		|| settings.deferred != m_settings.deferred) {
+		vt::log::error("[GFX] | RenderBatcher > Capture was made with other settings");
+		return false;
+	}
+
+	usize stride = _vertex_stride();
+	for (usize i = 0; i < capture.m_batches.size(); i += 1) {
+		const auto& batch = capture.m_batches[i];
+		m_cur_vertex = 0;
+		m_cur_index = 0;
+		m_cur_command = 0;
+		m_cur_instance = 0;
+
+		if (!_has_room(batch.vertex_count, batch.index_count, batch.instance_count)
+			|| batch.command_count > m_commands.size()
+			|| batch.uniform_size > m_uniform_buffer.size()) {
+			vt::log::error("[GFX] | RenderBatcher > Capture doesn't fit in the arenas");
+			_restore_pass();
+			return false;
+		}
+
+		const u8 *vertices = capture.m_vertices.data() + batch.vertex_idx * stride;
+		_visit_vertices([&](auto& arena) {
+			std::memcpy(arena.data(), vertices, batch.vertex_count * stride);
+		});
+
+		auto commands = std::span(capture.m_commands)
+							.subspan(batch.command_idx, batch.command_count);
+		std::copy(commands.begin(), commands.end(), m_commands.begin());
+
+		if (m_settings.indexed) {
+			auto indices = std::span(capture.m_indices)
+							   .subspan(batch.index_idx, batch.index_count);
+			std::copy(indices.begin(), indices.end(), m_indices.begin());
+		}
+
+		auto instances = std::span(capture.m_instances)
+							 .subspan(batch.instance_idx, batch.instance_count);
+		std::copy(instances.begin(), instances.end(), m_instances.begin());
+
+		auto uniforms = std::span(capture.m_uniforms)
+							.subspan(batch.uniform_idx, batch.uniform_size);
+		std::copy(uniforms.begin(), uniforms.end(), m_uniform_buffer.begin());
+
+		auto groups = std::span(capture.m_texture_groups)
+						  .subspan(batch.group_idx, batch.group_count);
+		m_texture_groups.assign(groups.begin(), groups.end());
+
+		m_cur_vertex = batch.vertex_count;
+		m_cur_index = batch.index_count;
+		m_cur_command = batch.command_count;
+		m_cur_instance = batch.instance_count;
+		m_cur_uniform = batch.uniform_size;
+
+		// Batches were drawn into one pass, chained like overflow flushes
+		if (i + 1 == capture.m_batches.size()) {
+			flush();
+			continue;
+		}
+
+		_store_pass();
+		if (!_submit()) {
+			vt::log::error("[GFX] | RenderBatcher > Replay of a batch failed");
+		}
+		m_texture_groups.clear();
+		_load_pass();
+	}
+
+	return true;
+}
+
+[[nodiscard]] const BatcherSettings& RenderBatcher::get_settings() const {
+	return m_settings;
+}
+
+[[nodiscard]] const BufferRingStats& RenderBatcher::get_ring_stats() const {
+	return m_ring_stats;
+}
+
+[[nodiscard]] const FrameStats& RenderBatcher::get_stats(u32 frames_ago) const {
+	static const FrameStats empty {};
+	if (frames_ago >= FRAME_STATS_HISTORY) {
+		return empty;
+	}
+
+	u32 slot = (m_stats_frame + FRAME_STATS_HISTORY - frames_ago) % FRAME_STATS_HISTORY;
+	return m_stats_history[slot];
+}
+
+bool RenderBatcher::_submit() {
 	u32 vertex_count = m_cur_vertex;
+	u32 index_count = m_cur_index;
 	u32 command_count = m_cur_command;
+	u32 instance_count = m_cur_instance;
 
 	// Rewind indexes
 	m_cur_vertex = 0;
+	m_cur_index = 0;
 	m_cur_command = 0;
-	m_cur_uniform = 0;
+	m_cur_instance = 0;
 
 	// Check if there's any command in this state
 	if (command_count == 0) {
-		return;
+		return false;
+	}
+
+	m_frame_stats.peak_vertices = std::max(m_frame_stats.peak_vertices, vertex_count);
+	m_frame_stats.peak_commands = std::max(m_frame_stats.peak_commands, command_count);
+
+	// Chained ranges are laid out first, captures only hold contiguous commands
+	if (!m_index_ranges.empty()) {
+		index_count = _gather_indices(command_count);
+	}
+
+	// Recorded before sorting, so a replay goes through the same work
+	if (m_capture) {
+		m_capture->_record_batch(
+			*this, command_count, vertex_count, index_count, instance_count
+		);
+	}
+
+	if (m_settings.deferred) {
+		index_count = _sort_commands(command_count);
+		_reset_order_grid();
+	} else {
+		_reset_merge_index();
+	}
+
+	// Arenas have grown since the buffers were made
+	if (m_stale_buffers) {
+		_destroy_stream_buffers();
+		if (!_make_stream_buffers()) {
+			return false;
+		}
+
+		// Every buffer is new, none is still read by the previous frame
+		m_frame_buffer = 0;
+		m_frame_buffers = 0;
+		m_last_frame_buffers = 0;
+		m_stale_buffers = false;
 	}
 
+	// Rotate stream buffers. A frame takes at most all but one buffer, so the
+	// next one always has a buffer left that this frame didn't write.
+	u32 buffer_count = m_settings.buffer_count;
+	u32 frame_buffers = std::min(buffer_count - m_last_frame_buffers, buffer_count - 1);
+
+	m_ring_stats.flushes += 1;
+	if (m_frame_buffers < std::max(frame_buffers, 1u)) {
+		m_frame_buffers += 1;
+		if ((m_frame_buffer + m_frame_buffers) % buffer_count == 0) {
+			m_ring_stats.wraps += 1;
+		}
+	} else {
+		m_ring_stats.frame_reuses += 1; // Out of buffers this frame
+	}
+
+	// Only a single buffer ring gets here, see `init`
+	if (m_frame_buffers > buffer_count - m_last_frame_buffers) {
+		m_ring_stats.last_frame_reuses += 1;
+	}
+
+	u32 buffer_idx = (m_frame_buffer + m_frame_buffers - 1) % buffer_count;
+
+	usize vertices_size = vertex_count * _vertex_stride();
+	usize indices_size = index_count * sizeof(u16);
+	usize instances_size = instance_count * sizeof(SpriteInstance);
+
+	// Overflow flushes upload whole batches, so a buffer already used this frame
+	// may not take another one. Replace it, the old one lives until the GPU is
+	// done with it.
+	if (sg_query_buffer_will_overflow(m_vertex_bufs[buffer_idx], vertices_size)
+		|| (m_settings.indexed
+			&& sg_query_buffer_will_overflow(m_index_bufs[buffer_idx], indices_size))
+		|| sg_query_buffer_will_overflow(m_instance_bufs[buffer_idx], instances_size)) {
+		_destroy_ring_slot(buffer_idx);
+		if (!_make_ring_slot(buffer_idx)) {
+			return false;
+		}
+
+		m_ring_stats.replacements += 1;
+	}
+
+	sg_buffer vertex_buf = m_vertex_bufs[buffer_idx];
+	sg_buffer index_buf = m_index_bufs[buffer_idx];
+	sg_buffer instance_buf = m_instance_bufs[buffer_idx];
+
 	sg_range vertices_range = {
-		.ptr = m_vertices.data(),
-		.size = vertex_count * sizeof(Vertex),
+		.ptr = _vertex_data(),
+		.size = vertices_size,
 	};
-	u32 offset = sg_append_buffer(m_vertex_buf, vertices_range);
-	if (sg_query_buffer_overflow(m_vertex_buf)) {
+	u32 offset = sg_append_buffer(vertex_buf, vertices_range);
+	if (sg_query_buffer_overflow(vertex_buf)) {
 		vt::log::error("[GFX] | RenderBatcher > Vertex buffer overflow");
-		return;
+		return false;
 	}
 
 	sg_pipeline cur_pipeline {};
@@ -252,9 +780,46 @@ void RenderBatcher::flush() {
 		.size = 0,
 	};
 
+	sg_buffer stream_index_buf {};
+	u32 index_offset = 0;
+	if (m_settings.indexed) {
+		sg_range indices_range = {
+			.ptr = m_settings.deferred ? m_sorted_indices.data() : m_indices.data(),
+			.size = indices_size,
+		};
+		stream_index_buf = index_buf;
+		index_offset = sg_append_buffer(index_buf, indices_range);
+		if (sg_query_buffer_overflow(index_buf)) {
+			vt::log::error("[GFX] | RenderBatcher > Index buffer overflow");
+			return false;
+		}
+	}
+
 	sg_bindings binds {};
-	binds.vertex_buffers[0] = m_vertex_buf;
+	binds.vertex_buffers[0] = vertex_buf;
 	binds.vertex_buffer_offsets[0] = offset;
+	binds.index_buffer = stream_index_buf;
+	binds.index_buffer_offset = index_offset;
+
+	u32 instance_offset = 0;
+	if (instance_count > 0) {
+		sg_range instances_range = {
+			.ptr = m_instances.data(),
+			.size = instances_size,
+		};
+		binds.vertex_buffers[1] = instance_buf;
+		instance_offset = sg_append_buffer(instance_buf, instances_range);
+		if (sg_query_buffer_overflow(instance_buf)) {
+			vt::log::error("[GFX] | RenderBatcher > Instance buffer overflow");
+			return false;
+		}
+	}
+
+	m_frame_stats.vertices_uploaded += vertex_count;
+	m_frame_stats.bytes_uploaded += vertices_size + instances_size;
+	if (m_settings.indexed) {
+		m_frame_stats.bytes_uploaded += indices_size;
+	}
 
 	sg_begin_pass(m_cur_pass);
 	auto commands = std::span(m_commands.begin(), command_count);
@@ -272,7 +837,7 @@ void RenderBatcher::flush() {
 
 		case BatchCommandType::Draw: {
 			DrawCommand draw = cmd.args.draw;
-			if (draw.vertex_count == 0) {
+			if (draw.element_count == 0) {
 				continue; // Nothing to do
 			}
 
@@ -283,10 +848,17 @@ void RenderBatcher::flush() {
 				sg_apply_pipeline(draw.pipeline);
 				cur_pipeline = draw.pipeline;
 				apply_bindings = true;
+				m_frame_stats.pipeline_changes += 1;
 			}
 
+			// Multi-texture draws bind the whole group their slots index into
+			const TexturesUniform& textures
+				= draw.texture_group != 0
+					? m_texture_groups[draw.texture_group - 1].textures
+					: draw.textures;
+
 			u32 slot = 0;
-			for (const auto& texture : draw.textures) {
+			for (const auto& texture : textures) {
 				sg_image img = texture.img;
 				sg_sampler smp {};
 				if (texture.img.id != SG_INVALID_ID) {
@@ -303,9 +875,30 @@ void RenderBatcher::flush() {
 				slot += 1;
 			}
 
+			// Retained geometry is drawn from its own buffers
+			bool retained = draw.vertex_buf.id != SG_INVALID_ID;
+			sg_buffer draw_vertex_buf = retained ? draw.vertex_buf : vertex_buf;
+			if (binds.vertex_buffers[0].id != draw_vertex_buf.id) {
+				binds.vertex_buffers[0] = draw_vertex_buf;
+				binds.vertex_buffer_offsets[0] = retained ? 0 : offset;
+				binds.index_buffer = retained ? draw.index_buf : stream_index_buf;
+				binds.index_buffer_offset = retained ? 0 : index_offset;
+				apply_bindings = true;
+			}
+
+			// Instanced draws read their own slice of the instance buffer
+			if (draw.instance_count > 0) {
+				i32 offset = instance_offset + draw.instance_idx * sizeof(SpriteInstance);
+				if (binds.vertex_buffer_offsets[1] != offset) {
+					binds.vertex_buffer_offsets[1] = offset;
+					apply_bindings = true;
+				}
+			}
+
 			if (apply_bindings) {
 				sg_apply_bindings(binds);
 				apply_uniforms = true;
+				m_frame_stats.binding_changes += 1;
 			}
 
 			if (cur_uniform_buffer != draw.uniform) {
@@ -323,191 +916,1119 @@ void RenderBatcher::flush() {
 						.size = uniform.size,
 					};
 					sg_apply_uniforms(0, range);
+					m_frame_stats.uniform_changes += 1;
 				}
 			}
 
-			sg_draw(draw.vertex_idx, draw.vertex_count, 1);
+			u32 instances = std::max(draw.instance_count, 1u);
+			sg_draw(draw.element_idx, draw.element_count, instances);
+			m_frame_stats.draw_calls += 1;
 		} break;
 
-		case BatchCommandType::None: break; // Command was merged
+		case BatchCommandType::None: { // Command was merged
+			m_frame_stats.skipped_commands += 1;
+		} break;
 		}
 	}
 
 	sg_end_pass();
-	reset();
+	return true;
 }
 
-bool RenderBatcher::_try_merge_command(const RenderBatcher::DrawCommand& draw) {
-	BatchCommand *prev_cmd = nullptr;
-	std::vector<BatchCommand *> inter_cmds;
-
-	u32 search_depth = _BATCH_MERGE_DEPTH;
-	for (u32 depth = 0; depth < search_depth; depth += 1) {
-		BatchCommand *cmd = _prev_command(depth + 1);
-		if (!cmd) {
-			break;
+bool RenderBatcher::_make_stream_buffers() {
+	for (u32 i = 0; i < m_settings.buffer_count; i += 1) {
+		if (!_make_ring_slot(i)) {
+			return false;
 		}
+	}
 
-		// Check if command was already merged
-		if (cmd->type == BatchCommandType::None) {
-			search_depth += 1; // Search even deeper
-			continue;
-		}
+	return true;
+}
 
-		// Stop if command isn't a drawing command
-		if (cmd->type != BatchCommandType::Draw) {
-			break;
-		}
+void RenderBatcher::_destroy_stream_buffers() {
+	for (u32 i = 0; i < _MAX_BUFFER_COUNT; i += 1) {
+		_destroy_ring_slot(i);
+	}
+}
 
-		// Check if command has the same data
-		if (cmd->args.draw.pipeline.id == draw.pipeline.id
-			&& cmd->args.draw.uniform == draw.uniform
-			&& cmd->args.draw.textures == draw.textures) {
-			prev_cmd = cmd;
-			break;
+bool RenderBatcher::_make_ring_slot(u32 slot) {
+	sg_buffer_desc bufdesc {};
+	bufdesc.size = _vertex_capacity() * _vertex_stride();
+	bufdesc.usage.vertex_buffer = true;
+	bufdesc.usage.stream_update = true;
+	bufdesc.label = "vt_render_batcher.vertex_buffer";
+
+	m_vertex_bufs[slot] = sg_make_buffer(bufdesc);
+	if (sg_query_buffer_state(m_vertex_bufs[slot]) != SG_RESOURCESTATE_VALID) {
+		vt::log::error("[GFX] | RenderBatcher > Failed to make vertex buffer handler");
+		return false;
+	}
+
+	if (m_settings.indexed) {
+		sg_buffer_desc idxdesc {};
+		idxdesc.size = m_indices.capacity() * sizeof(u16);
+		idxdesc.usage.index_buffer = true;
+		idxdesc.usage.stream_update = true;
+		idxdesc.label = "vt_render_batcher.index_buffer";
+
+		m_index_bufs[slot] = sg_make_buffer(idxdesc);
+		if (sg_query_buffer_state(m_index_bufs[slot]) != SG_RESOURCESTATE_VALID) {
+			vt::log::error("[GFX] | RenderBatcher > Failed to make index buffer handler");
+			return false;
 		}
+	}
+
+	sg_buffer_desc instdesc {};
+	instdesc.size = m_instances.capacity() * sizeof(SpriteInstance);
+	instdesc.usage.vertex_buffer = true;
+	instdesc.usage.stream_update = true;
+	instdesc.label = "vt_render_batcher.instance_buffer";
 
-		inter_cmds.push_back(cmd);
+	m_instance_bufs[slot] = sg_make_buffer(instdesc);
+	if (sg_query_buffer_state(m_instance_bufs[slot]) != SG_RESOURCESTATE_VALID) {
+		vt::log::error("[GFX] | RenderBatcher > Failed to make instance buffer handler");
+		return false;
 	}
 
-	if (!prev_cmd) {
-		return false; // Failed to merge
+	return true;
+}
+
+void RenderBatcher::_destroy_ring_slot(u32 slot) {
+	if (sg_query_buffer_state(m_vertex_bufs[slot]) != SG_RESOURCESTATE_INVALID) {
+		sg_destroy_buffer(m_vertex_bufs[slot]);
+	}
+
+	if (sg_query_buffer_state(m_index_bufs[slot]) != SG_RESOURCESTATE_INVALID) {
+		sg_destroy_buffer(m_index_bufs[slot]);
 	}
 
-	// Only allow merging if current or previous draw command doesn't touch
-	// any intermediate commands
-	bool overlaps_next = false;
-	bool overlaps_prev = false;
-	Rect prev_region = prev_cmd->args.draw.region;
+	if (sg_query_buffer_state(m_instance_bufs[slot]) != SG_RESOURCESTATE_INVALID) {
+		sg_destroy_buffer(m_instance_bufs[slot]);
+	}
+}
 
-	for (const auto& cmd : inter_cmds) {
-		const Rect& region = cmd->args.draw.region;
-		if (region.intersects(draw.region)) {
-			overlaps_next = true;
-			if (overlaps_prev) {
-				return false; // Cannot overlap with previous region
-			}
+void RenderBatcher::_reserve(u32 vertices, u32 indices, u32 instances) {
+	if (_has_room(vertices, indices, instances)) {
+		return;
+	}
+
+	switch (m_settings.overflow) {
+	case OverflowPolicy::Flush: _flush_overflow(); break;
+	case OverflowPolicy::Grow:
+		// Indexed vertices can't grow past u16 indices, flush instead
+		if (!_grow_arenas(vertices, indices, instances)) {
+			_flush_overflow();
+		}
+		break;
+	case OverflowPolicy::Drop: break; // Allocation fails and logs
+	}
+}
+
+bool RenderBatcher::_has_room(u32 vertices, u32 indices, u32 instances) const {
+	return m_cur_vertex + vertices < _vertex_capacity()
+		&& (!m_settings.indexed || m_cur_index + indices < m_indices.size())
+		&& m_cur_instance + instances <= m_instances.size()
+		&& m_cur_command + _DRAW_COMMANDS <= m_commands.size();
+}
+
+bool RenderBatcher::_grow_arenas(u32 vertices, u32 indices, u32 instances) {
+	auto grown = [](usize capacity, usize needed) {
+		capacity = std::max<usize>(capacity, 1);
+		while (capacity < needed) {
+			capacity *= 2;
 		}
+		return capacity;
+	};
+
+	// NOTE: Vertices and indices always keep one free element, see `_get_vertices`
+	usize vertex_capacity = grown(_vertex_capacity(), m_cur_vertex + vertices + 1);
+	if (m_settings.indexed && vertex_capacity > _MAX_INDEXED_VERTICES) {
+		return false;
+	}
+
+	usize command_capacity = grown(m_commands.size(), m_cur_command + _DRAW_COMMANDS);
+	usize instance_capacity = grown(m_instances.size(), m_cur_instance + instances);
 
-		if (prev_region.intersects(draw.region)) {
-			overlaps_prev = true;
-			if (overlaps_next) {
-				return false; // Cannot overlap with next region
+	if (vertex_capacity != _vertex_capacity()) {
+		vt::log::warn("[GFX] | RenderBatcher > Growing vertices to {}", vertex_capacity);
+		_visit_vertices([&](auto& arena) { arena.resize(vertex_capacity); });
+		m_settings.max_vertices = vertex_capacity;
+		m_stale_buffers = true;
+	}
+
+	if (m_settings.indexed) {
+		usize index_capacity = grown(m_indices.size(), m_cur_index + indices + 1);
+		if (index_capacity != m_indices.size()) {
+			vt::log::warn(
+				"[GFX] | RenderBatcher > Growing indices to {}", index_capacity
+			);
+			m_indices.resize(index_capacity);
+			m_settings.max_indices = index_capacity;
+			m_stale_buffers = true;
+
+			if (m_settings.deferred || m_settings.indirect_merge) {
+				m_sorted_indices.resize(index_capacity);
 			}
 		}
 	}
 
-	if (!overlaps_next) { // Merge with previous command
-		if (!inter_cmds.empty()) {
-			// Check if there's enough vertices space
-			if (m_cur_vertex + draw.vertex_count >= m_vertices.capacity()) {
-				return false;
+	if (instance_capacity != m_instances.size()) {
+		vt::log::warn(
+			"[GFX] | RenderBatcher > Growing instances to {}", instance_capacity
+		);
+		m_instances.resize(instance_capacity);
+		m_settings.max_instances = instance_capacity;
+		m_stale_buffers = true;
+	}
+
+	// Commands stay on the CPU
+	if (command_capacity != m_commands.size()) {
+		vt::log::warn(
+			"[GFX] | RenderBatcher > Growing commands to {}", command_capacity
+		);
+		m_commands.resize(command_capacity);
+		m_settings.max_commands = command_capacity;
+
+		if (m_settings.deferred) {
+			m_sort_entries.resize(command_capacity);
+			m_sort_scratch.resize(command_capacity);
+			m_sorted_commands.resize(command_capacity);
+		}
+	}
+
+	return true;
+}
+
+void RenderBatcher::_store_pass() {
+	if (!m_pass_resumed) {
+		m_pass_action = m_cur_pass.action;
+		m_pass_resumed = true;
+	}
+
+	sg_pass_action& action = m_cur_pass.action;
+	for (auto& color : action.colors) {
+		color.store_action = SG_STOREACTION_STORE;
+	}
+	action.depth.store_action = SG_STOREACTION_STORE;
+	action.stencil.store_action = SG_STOREACTION_STORE;
+}
+
+void RenderBatcher::_load_pass() {
+	sg_pass_action& action = m_cur_pass.action;
+	for (auto& color : action.colors) {
+		color.load_action = SG_LOADACTION_LOAD;
+	}
+	action.depth.load_action = SG_LOADACTION_LOAD;
+	action.stencil.load_action = SG_LOADACTION_LOAD;
+}
+
+void RenderBatcher::_restore_pass() {
+	if (m_pass_resumed) {
+		m_cur_pass.action = m_pass_action;
+		m_pass_resumed = false;
+	}
+}
+
+void RenderBatcher::_flush_overflow() {
+	if (m_cur_command == 0) {
+		return; // Nothing to make room for
+	}
+
+	// Store what was drawn so far, the resumed pass loads it back
+	_store_pass();
+
+	// Drawing carries on even if the buffers couldn't be remade for this batch
+	if (!_submit()) {
+		vt::log::error("[GFX] | RenderBatcher > Overflow flush failed, batch dropped");
+		m_frame_stats.overflow_drops += 1;
+	}
+	m_texture_groups.clear();
+
+	_load_pass();
+
+	// Commands were consumed, restore the target of the current state
+	BatchCommand *viewport_cmd = _next_command();
+	if (!viewport_cmd) {
+		return;
+	}
+
+	std::memset(viewport_cmd, 0, sizeof(BatchCommand));
+	viewport_cmd->type = BatchCommandType::Viewport;
+	viewport_cmd->args.viewport = m_state.viewport;
+
+	BatchCommand *scissor_cmd = _next_command();
+	if (!scissor_cmd) {
+		return;
+	}
+
+	std::memset(scissor_cmd, 0, sizeof(BatchCommand));
+	scissor_cmd->type = BatchCommandType::Scissor;
+	scissor_cmd->args.scissor = m_state.scissor;
+
+	_split_draws();
+}
+
+void RenderBatcher::_submit_draw(
+	DrawCommand draw,
+	sg_primitive_type primitive,
+	const DrawOrder& order,
+	u32 vertex_count,
+	u32 index_count
+) {
+	// Use the common pipeline unless state has set one
+	// NOTE: In indexed mode custom pipelines must use `SG_INDEXTYPE_UINT16`
+	if (draw.pipeline.id == SG_INVALID_ID) {
+		sg_index_type index_type = m_settings.indexed ? SG_INDEXTYPE_UINT16
+													  : SG_INDEXTYPE_NONE;
+		draw.pipeline = vt::make_pipeline(
+			primitive,
+			index_type,
+			m_settings.vertex_format,
+			_get_draw_pass(order.translucent)
+		);
+		draw.uniform = UniformBuffer {};
+	}
+
+	if (sg_query_pipeline_state(draw.pipeline) != SG_RESOURCESTATE_VALID) {
+		m_cur_vertex -= vertex_count; // Rewind vertices
+		m_cur_index -= index_count;
+		m_cur_instance -= draw.instance_count;
+		return;
+	}
+
+	draw.mergeable = primitive != SG_PRIMITIVETYPE_LINE_STRIP
+				  && primitive != SG_PRIMITIVETYPE_TRIANGLE_STRIP
+				  && draw.instance_count == 0
+				  && draw.vertex_buf.id == SG_INVALID_ID;
+
+	// Try to merge command with any previous command, deferred mode sorts them
+	// on flush instead
+	u32 state = _hash_state(draw);
+	if (!m_settings.deferred && draw.mergeable && _try_merge_command(draw, state)) {
+		return; // Succefully merged
+	}
+
+	BatchCommand *cmd = _next_command();
+	if (!cmd) {
+		m_cur_vertex -= vertex_count; // Rewind vertices
+		m_cur_index -= index_count;
+		m_cur_instance -= draw.instance_count;
+		return;
+	}
+
+	std::memset(cmd, 0, sizeof(BatchCommand));
+	cmd->type = BatchCommandType::Draw;
+	cmd->args.draw = draw;
+
+	if (m_settings.deferred) {
+		cmd->args.draw.sort_key = _make_sort_key(draw, order, state);
+	} else {
+		_track_command(m_cur_command - 1, state);
+	}
+}
+
+DrawPass RenderBatcher::_get_draw_pass(bool translucent) const {
+	if (!m_settings.depth_sorted) {
+		return DrawPass::Unsorted;
+	}
+
+	return translucent ? DrawPass::Translucent : DrawPass::Opaque;
+}
+
+RenderBatcher::DrawOrder RenderBatcher::_make_draw_order(f32 depth) const {
+	return DrawOrder {
+		.layer = m_state.layer,
+		.translucent = m_state.translucent,
+		.depth = depth,
+	};
+}
+
+void RenderBatcher::_stitch_contexts() {
+	for (auto& context : m_contexts) {
+		for (const auto& draw : context.m_draws) {
+			_reserve(draw.vertex_count, draw.index_count);
+			_apply_target(draw.viewport, draw.scissor);
+
+			u32 vertex_idx = m_cur_vertex;
+			auto src = std::span(context.m_vertices).subspan(
+				draw.vertex_idx, draw.vertex_count
+			);
+			bool copied = _visit_vertices([&](auto& arena) {
+				auto vertices = _get_vertices(arena, draw.vertex_count);
+				if (vertices.empty()) {
+					return false;
+				}
+
+				// Contexts always record the standard format
+				using V = typename std::decay_t<decltype(arena)>::value_type;
+				for (u32 i = 0; i < draw.vertex_count; i += 1) {
+					vertices[i] = V { src[i] };
+				}
+				return true;
+			});
+			if (!copied) {
+				break;
 			}
 
-			u32 end_vertex = prev_cmd->args.draw.vertex_idx
-						   + prev_cmd->args.draw.vertex_count;
-			u32 vertex_count = m_cur_vertex - end_vertex;
+			u32 index_idx = m_cur_index;
+			if (m_settings.indexed) {
+				auto indices = _get_indices(draw.index_count);
+				if (indices.empty()) {
+					m_cur_vertex -= draw.vertex_count; // Rewind vertices
+					break;
+				}
 
-			// Avoid moving large chunks of memory
-			if (vertex_count > _MAX_MOVE_VERTICES) {
-				return false;
+				// Context indices are relative to the draw's first vertex
+				for (u32 i = 0; i < draw.index_count; i += 1) {
+					indices[i] = vertex_idx + context.m_indices[draw.index_idx + i];
+				}
 			}
 
-			// Insert vertices after previous command vertices
-			// NOTE: Don't use `std::vector.insert()` since we don't want the
-			// vector's size to change
-			std::memmove(
-				&m_vertices[end_vertex + vertex_count], &m_vertices[end_vertex],
-				vertex_count * sizeof(Vertex)
-			);
-			std::memcpy(
-				&m_vertices[end_vertex], &m_vertices[draw.vertex_idx + draw.vertex_count],
-				draw.vertex_count * sizeof(Vertex)
+			DrawCommand cmd {};
+			cmd.region = draw.region;
+			cmd.textures = draw.textures;
+			cmd.pipeline = draw.pipeline;
+			cmd.uniform = draw.uniform;
+			cmd.element_idx = m_settings.indexed ? index_idx : vertex_idx;
+			cmd.element_count = m_settings.indexed ? draw.index_count : draw.vertex_count;
+			_assign_texture_slot(cmd, vertex_idx, draw.vertex_count);
+
+			DrawOrder order {
+				.layer = draw.layer,
+				.translucent = draw.translucent,
+				.depth = draw.depth,
+			};
+			_submit_draw(
+				cmd, draw.primitive, order, draw.vertex_count, draw.index_count
 			);
+		}
 
-			// Offset indexes from intermediate commands
-			for (auto& cmd : inter_cmds) {
-				cmd->args.draw.vertex_idx += draw.vertex_count;
-			}
+		context.clear();
+	}
+}
+
+void RenderBatcher::_apply_target(const Rect& viewport, const Rect& scissor) {
+	if (m_state.viewport != viewport) {
+		auto *cmd = _next_command();
+		if (!cmd) {
+			return;
 		}
 
-		// Update render region
-		prev_region.x1 = std::min(prev_region.x1, draw.region.x1);
-		prev_region.y1 = std::min(prev_region.y1, draw.region.y1);
-		prev_region.x2 = std::max(prev_region.x2, draw.region.x2);
-		prev_region.y2 = std::max(prev_region.y2, draw.region.y2);
+		std::memset(cmd, 0, sizeof(BatchCommand));
+		cmd->type = BatchCommandType::Viewport;
+		cmd->args.viewport = viewport;
+
+		m_state.viewport = viewport;
+		m_state.proj = Mat4::ortho(0.0, viewport.w, viewport.h, 0.0);
 
-		prev_cmd->args.draw.vertex_count += draw.vertex_count;
-		prev_cmd->args.draw.region = prev_region;
-	} else { // Merge with next command
-		assert(!inter_cmds.empty());
+		_split_draws(); // Draws are never sorted or merged across viewport changes
+	}
 
-		// Push a new command
-		BatchCommand *cmd = _next_command();
+	if (m_state.scissor != scissor) {
+		auto *cmd = _next_command();
 		if (!cmd) {
-			return false;
+			return;
 		}
 
-		u32 vertex_count = prev_cmd->args.draw.vertex_count;
+		std::memset(cmd, 0, sizeof(BatchCommand));
+		cmd->type = BatchCommandType::Scissor;
+		cmd->args.scissor = scissor;
 
-		// Check if there's enough vertices space
-		if (m_cur_vertex + vertex_count >= m_vertices.capacity()) {
-			return false;
+		m_state.scissor = scissor;
+
+		_split_draws(); // Draws are never sorted or merged across scissor changes
+	}
+
+	_update_clip();
+}
+
+void RenderBatcher::_set_offscreen_target(const sg_attachments& attachments, Point size) {
+	m_state.framesize = size;
+	m_cur_pass.attachments = attachments;
+	m_cur_pass.swapchain = sg_swapchain {};
+
+	m_state.view = View {};
+	m_state.proj = Mat4::ortho(0.0, m_state.framesize.w, m_state.framesize.h, 0.0);
+	apply_viewport(0.0, 0.0, m_state.framesize.w, m_state.framesize.h);
+	apply_scissor(0.0, 0.0, -1.0, -1.0);
+}
+
+void RenderBatcher::_update_clip() {
+	const Rect& viewport = m_state.viewport;
+	const Rect& scissor = m_state.scissor;
+
+	m_state.clip = Rect { -1.0, -1.0, 1.0, 1.0 };
+	if (viewport.w <= 0.0 || viewport.h <= 0.0) {
+		return;
+	}
+
+	// The projection maps the viewport top left to (-1, 1)
+	f32 x1 = (scissor.x - viewport.x) / viewport.w * 2.0f - 1.0f;
+	f32 x2 = (scissor.x + scissor.w - viewport.x) / viewport.w * 2.0f - 1.0f;
+	f32 y1 = 1.0f - (scissor.y + scissor.h - viewport.y) / viewport.h * 2.0f;
+	f32 y2 = 1.0f - (scissor.y - viewport.y) / viewport.h * 2.0f;
+
+	m_state.clip.x1 = std::max(m_state.clip.x1, x1);
+	m_state.clip.y1 = std::max(m_state.clip.y1, y1);
+	m_state.clip.x2 = std::min(m_state.clip.x2, x2);
+	m_state.clip.y2 = std::min(m_state.clip.y2, y2);
+}
+
+bool RenderBatcher::_try_merge_command(
+	const RenderBatcher::DrawCommand& draw,
+	u32 state
+) {
+	// Only the latest command of a state is a candidate, older ones are behind it
+	const MergeSlot& slot = _get_merge_slot(state);
+	if (slot.state != state || slot.command <= m_merge_barrier) {
+		return false; // Failed to merge
+	}
+
+	u32 prev_idx = slot.command - 1;
+	BatchCommand& prev_cmd = m_commands[prev_idx];
+	if (prev_cmd.type != BatchCommandType::Draw
+		|| !_has_same_state(prev_cmd.args.draw, draw)) {
+		return false; // Hash collision
+	}
+
+	// Merging moves one of the draws across the commands between them, so only
+	// allow it if the moved draw doesn't touch any of them. The grid tells the
+	// latest command drawn over a region, close commands are also compared one
+	// by one since cells are coarse.
+	DrawCommand& prev = prev_cmd.args.draw;
+	bool overlaps_next = _find_merge_overlap(draw.region) > slot.command;
+	bool overlaps_prev = overlaps_next;
+
+	if (overlaps_next && m_cur_command - slot.command <= _MERGE_SCAN_DEPTH) {
+		overlaps_next = false;
+		overlaps_prev = false;
+
+		for (u32 i = slot.command; i < m_cur_command; i += 1) {
+			if (m_commands[i].type != BatchCommandType::Draw) {
+				continue; // Already merged
+			}
+
+			const Rect& region = m_commands[i].args.draw.region;
+			overlaps_next = overlaps_next || region.intersects(draw.region);
+			overlaps_prev = overlaps_prev || region.intersects(prev.region);
+		}
+	}
+
+	// Previous region spans every draw merged into it, so it's looked up last
+	if (overlaps_next && overlaps_prev) {
+		overlaps_prev = _find_merge_overlap(prev.region) > slot.command;
+	}
+
+	if (overlaps_next && overlaps_prev) {
+		return false; // Neither draw can be moved
+	}
+
+	// Update render region
+	Rect region = prev.region;
+	region.x1 = std::min(region.x1, draw.region.x1);
+	region.y1 = std::min(region.y1, draw.region.y1);
+	region.x2 = std::max(region.x2, draw.region.x2);
+	region.y2 = std::max(region.y2, draw.region.y2);
+
+	u32 draw_end = draw.element_idx + draw.element_count;
+	u32 prev_end = prev.element_idx + prev.element_count;
+
+	if (!overlaps_next) { // Merge with previous command
+		if (m_settings.indirect_merge) {
+			_chain_index_range(prev, draw.element_idx, draw.element_count);
+		} else if (prev_end != draw.element_idx) {
+			// Avoid moving large chunks of memory
+			if (draw_end - prev_end > _MAX_MOVE_VERTICES) {
+				return false;
+			}
+
+			// Move current elements right after the previous command ones
+			_rotate_elements(prev_end, draw.element_idx, draw_end);
+
+			// Offset indexes from intermediate commands, retained ones index
+			// their own buffers
+			for (u32 i = prev_idx + 1; i < m_cur_command; i += 1) {
+				DrawCommand& inter = m_commands[i].args.draw;
+				if (m_commands[i].type == BatchCommandType::Draw
+					&& inter.vertex_buf.id == SG_INVALID_ID) {
+					inter.element_idx += draw.element_count;
+				}
+			}
 		}
 
+		prev.element_count += draw.element_count;
+		prev.region = region;
+		_mark_merge_grid(draw.region, slot.command);
+		m_frame_stats.merged_prev += 1;
+	} else { // Merge with next command
 		// Avoid moving large chunks of memory
-		if (vertex_count > _MAX_MOVE_VERTICES) {
+		if (!m_settings.indirect_merge
+			&& draw.element_idx - prev.element_idx > _MAX_MOVE_VERTICES) {
 			return false;
 		}
 
-		// Merge previous and current vertices
-		// NOTE: Don't use `std::vector.insert()` since we don't want the
-		// vector's size to change
-		std::memmove(
-			&m_vertices[draw.vertex_idx + vertex_count], &m_vertices[draw.vertex_idx],
-			vertex_count * sizeof(Vertex)
-		);
-		std::memcpy(
-			&m_vertices[draw.vertex_idx], &m_vertices[prev_cmd->args.draw.vertex_idx],
-			vertex_count * sizeof(Vertex)
-		);
+		// Push a new command
+		BatchCommand *cmd = _next_command();
+		if (!cmd) {
+			return false;
+		}
 
-		m_cur_vertex += draw.vertex_count;
+		DrawCommand merged = draw;
+		merged.region = region;
 
-		// Update render region
-		prev_region.x1 = std::min(prev_region.x1, draw.region.x1);
-		prev_region.y1 = std::min(prev_region.y1, draw.region.y1);
-		prev_region.x2 = std::max(prev_region.x2, draw.region.x2);
-		prev_region.y2 = std::max(prev_region.y2, draw.region.y2);
+		if (m_settings.indirect_merge) {
+			// Previous ranges are drawn first
+			merged.element_idx = prev.element_idx;
+			merged.element_count = prev.element_count;
+			merged.index_range = prev.index_range;
+			_chain_index_range(merged, draw.element_idx, draw.element_count);
+			merged.element_count += draw.element_count;
+		} else {
+			// Move previous elements right before the current ones
+			_rotate_elements(prev.element_idx, prev_end, draw.element_idx);
+
+			// Offset indexes from intermediate commands
+			for (u32 i = prev_idx + 1; i < m_cur_command - 1; i += 1) {
+				DrawCommand& inter = m_commands[i].args.draw;
+				if (m_commands[i].type == BatchCommandType::Draw
+					&& inter.vertex_buf.id == SG_INVALID_ID) {
+					inter.element_idx -= prev.element_count;
+				}
+			}
+
+			merged.element_idx = draw.element_idx - prev.element_count;
+			merged.element_count = draw.element_count + prev.element_count;
+		}
 
 		// Setup new command
 		std::memset(cmd, 0, sizeof(BatchCommand));
 		cmd->type = BatchCommandType::Draw;
-		cmd->args.draw.pipeline = draw.pipeline;
-		cmd->args.draw.region = prev_region;
-		cmd->args.draw.vertex_idx = draw.vertex_idx;
-		cmd->args.draw.vertex_count = draw.vertex_count + vertex_count;
+		cmd->args.draw = merged;
 
-		prev_cmd->type = BatchCommandType::None; // Skip previous command
+		prev_cmd.type = BatchCommandType::None; // Skip previous command
+		_track_command(m_cur_command - 1, state);
+		m_frame_stats.merged_next += 1;
 	}
 
 	return true;
 }
 
-std::span<Vertex> RenderBatcher::_get_vertices(u32 count) {
-	if (m_cur_vertex + count >= m_vertices.capacity()) {
+void RenderBatcher::_track_command(u32 command_idx, u32 state) {
+	const DrawCommand& draw = m_commands[command_idx].args.draw;
+	_mark_merge_grid(draw.region, command_idx + 1);
+
+	if (draw.mergeable) {
+		_get_merge_slot(state) = MergeSlot { state, command_idx + 1 };
+	}
+}
+
+RenderBatcher::MergeSlot& RenderBatcher::_get_merge_slot(u32 state) {
+	// Linear probing, a slot from before the barrier is as good as a free one.
+	// If the probed slots are all taken the first one is evicted, which only
+	// costs merges.
+	u32 mask = _MERGE_STATE_SLOTS - 1;
+	u32 first = state & mask;
+	for (u32 probe = 0; probe < _MERGE_STATE_PROBES; probe += 1) {
+		MergeSlot& slot = m_merge_states[(first + probe) & mask];
+		if (slot.state == state || slot.command <= m_merge_barrier) {
+			return slot;
+		}
+	}
+
+	return m_merge_states[first];
+}
+
+u32 RenderBatcher::_find_merge_overlap(const Rect& region) const {
+	GridRange range = _get_grid_range(region, _MERGE_GRID_SIZE);
+
+	u32 latest = 0;
+	for (i32 y = range.y1; y <= range.y2; y += 1) {
+		for (i32 x = range.x1; x <= range.x2; x += 1) {
+			latest = std::max(latest, m_merge_grid[y * _MERGE_GRID_SIZE + x]);
+		}
+	}
+
+	return latest;
+}
+
+void RenderBatcher::_mark_merge_grid(const Rect& region, u32 command) {
+	GridRange range = _get_grid_range(region, _MERGE_GRID_SIZE);
+
+	for (i32 y = range.y1; y <= range.y2; y += 1) {
+		for (i32 x = range.x1; x <= range.x2; x += 1) {
+			u32& cell = m_merge_grid[y * _MERGE_GRID_SIZE + x];
+			cell = std::max(cell, command);
+		}
+	}
+}
+
+void RenderBatcher::_reset_merge_index() {
+	m_merge_grid.fill(0);
+	m_merge_states.fill(MergeSlot {});
+	m_merge_barrier = 0;
+}
+
+void RenderBatcher::_split_draws() {
+	if (m_settings.deferred) {
+		_reset_order_grid();
+	} else {
+		m_merge_barrier = m_cur_command;
+	}
+}
+
+RenderBatcher::GridRange RenderBatcher::_get_grid_range(
+	const Rect& region,
+	i32 grid_size
+) {
+	auto to_cell = [grid_size](f32 ndc) {
+		i32 cell = (i32)((ndc + 1.0f) * 0.5f * grid_size);
+		return std::clamp(cell, 0, grid_size - 1);
+	};
+
+	return GridRange {
+		to_cell(region.x1), to_cell(region.y1), to_cell(region.x2), to_cell(region.y2)
+	};
+}
+
+u32 RenderBatcher::_hash_state(const DrawCommand& draw) {
+	// FNV-1a over everything that prevents two draws from being merged
+	u32 state = 2166136261u;
+	auto hash = [&state](u32 value) {
+		state = (state ^ value) * 16777619u;
+	};
+
+	hash(draw.pipeline.id);
+	hash(draw.vertex_buf.id);
+	hash(draw.uniform.offset);
+	hash(draw.uniform.size);
+	hash(draw.texture_group);
+	for (const auto& texture : draw.textures) {
+		hash(texture.img.id);
+		hash(texture.smp.id);
+	}
+
+	return state;
+}
+
+bool RenderBatcher::_has_same_state(const DrawCommand& a, const DrawCommand& b) {
+	return a.pipeline.id == b.pipeline.id	  //
+		&& a.vertex_buf.id == b.vertex_buf.id //
+		&& a.uniform == b.uniform			  //
+		&& a.texture_group == b.texture_group //
+		&& a.textures == b.textures;
+}
+
+u64 RenderBatcher::_make_sort_key(
+	const DrawCommand& draw,
+	const DrawOrder& order,
+	u32 state
+) {
+	u64 layer = order.layer;
+	i32 band = 0;
+	if (m_settings.depth_sorted) {
+		band = (i32)((order.depth + 1.0f) * 0.5f * _DEPTH_BANDS);
+		band = std::clamp(band, 0, _DEPTH_BANDS - 1);
+
+		// Opaque draws of a layer come first, front to back. Overlap doesn't
+		// matter to them, so draws of a depth band are grouped by state.
+		if (!order.translucent) {
+			return (layer << 56) | ((u64)band << 47) | state;
+		}
+
+		band = _DEPTH_BANDS - 1 - band; // Translucent ones go back to front
+	}
+
+	GridRange range = _get_grid_range(draw.region, _ORDER_GRID_SIZE);
+
+	// Go one level above anything overlapped with a different state, so it
+	// stays drawn after it once sorted. Same state draws share the level.
+	u32 level = 0;
+	for (i32 y = range.y1; y <= range.y2; y += 1) {
+		for (i32 x = range.x1; x <= range.x2; x += 1) {
+			const OrderCell& cell = m_order_grid[y * _ORDER_GRID_SIZE + x];
+			if (cell.level == 0) {
+				continue;
+			}
+
+			u32 needed = cell.level - 1;
+			if (cell.mixed || cell.state != state) {
+				needed += 1;
+			}
+			level = std::max(level, needed);
+		}
+	}
+
+	// Levels grow by one at most per draw
+	assert(level <= _MAX_ORDER_LEVEL);
+
+	for (i32 y = range.y1; y <= range.y2; y += 1) {
+		for (i32 x = range.x1; x <= range.x2; x += 1) {
+			OrderCell& cell = m_order_grid[y * _ORDER_GRID_SIZE + x];
+			if (cell.level < level + 1) {
+				cell = OrderCell { .level = level + 1, .state = state, .mixed = false };
+			} else if (cell.level == level + 1 && cell.state != state) {
+				cell.mixed = true;
+			}
+		}
+	}
+
+	if (m_settings.depth_sorted) {
+		// Layer | translucent bit | depth band | overlap level | state hash
+		u64 key = (layer << 56) | (1ull << 55) | ((u64)band << 47);
+		return key | ((u64)std::min(level, 0x7fffffu) << 24) | (state & 0xffffff);
+	}
+
+	return (layer << 56) | ((u64)level << 32) | state;
+}
+
+void RenderBatcher::_reset_order_grid() {
+	m_order_grid.fill(OrderCell {});
+}
+
+u32 RenderBatcher::_sort_commands(u32 command_count) {
+	u32 index_count = 0;
+	u32 first = 0;
+
+	while (first < command_count) {
+		// Viewport and scissor commands split draws into segments which are
+		// sorted separately
+		if (m_commands[first].type != BatchCommandType::Draw) {
+			first += 1;
+			continue;
+		}
+
+		u32 last = first;
+		while (last < command_count && m_commands[last].type == BatchCommandType::Draw) {
+			u32 idx = last - first;
+			m_sorted_commands[idx] = m_commands[last];
+			m_sort_entries[idx] = SortEntry { m_commands[last].args.draw.sort_key, idx };
+			last += 1;
+		}
+
+		u32 count = last - first;
+		_sort_entries(count);
+
+		// Concatenate indices in sorted order, merging draws that share state
+		DrawCommand *batch = nullptr;
+		u32 cmd_idx = first;
+
+		for (u32 i = 0; i < count; i += 1) {
+			const BatchCommand& cmd = m_sorted_commands[m_sort_entries[i].command_idx];
+			const DrawCommand& draw = cmd.args.draw;
+
+			// Retained geometry keeps indexing its own buffers
+			if (draw.vertex_buf.id != SG_INVALID_ID) {
+				m_commands[cmd_idx] = cmd;
+				batch = &m_commands[cmd_idx].args.draw;
+				cmd_idx += 1;
+				continue;
+			}
+
+			std::copy_n(
+				m_indices.begin() + draw.element_idx, draw.element_count,
+				m_sorted_indices.begin() + index_count
+			);
+
+			if (batch && batch->mergeable && draw.mergeable
+				&& _has_same_state(*batch, draw)) {
+				batch->element_count += draw.element_count;
+				m_frame_stats.merged_prev += 1;
+			} else {
+				m_commands[cmd_idx] = cmd;
+				batch = &m_commands[cmd_idx].args.draw;
+				batch->element_idx = index_count;
+				cmd_idx += 1;
+			}
+
+			index_count += draw.element_count;
+		}
+
+		// Remaining commands were merged
+		for (; cmd_idx < last; cmd_idx += 1) {
+			m_commands[cmd_idx].type = BatchCommandType::None;
+		}
+
+		first = last;
+	}
+
+	return index_count;
+}
+
+void RenderBatcher::_sort_entries(u32 count) {
+	SortEntry *src = m_sort_entries.data();
+	SortEntry *dst = m_sort_scratch.data();
+
+	// Insertion sort is cheaper than clearing histograms for tiny segments
+	if (count < 32) {
+		for (u32 i = 1; i < count; i += 1) {
+			SortEntry entry = src[i];
+			u32 j = i;
+			for (; j > 0 && src[j - 1].key > entry.key; j -= 1) {
+				src[j] = src[j - 1];
+			}
+			src[j] = entry;
+		}
+		return;
+	}
+
+	// LSD radix sort on 8 bits digits, stable so equal keys keep submission order
+	for (u32 shift = 0; shift < 64; shift += 8) {
+		u32 offsets[256] = {};
+		for (u32 i = 0; i < count; i += 1) {
+			offsets[(src[i].key >> shift) & 0xff] += 1;
+		}
+
+		// Skip digits shared by every key
+		if (offsets[(src[0].key >> shift) & 0xff] == count) {
+			continue;
+		}
+
+		u32 total = 0;
+		for (u32& offset : offsets) {
+			u32 digit_count = offset;
+			offset = total;
+			total += digit_count;
+		}
+
+		for (u32 i = 0; i < count; i += 1) {
+			dst[offsets[(src[i].key >> shift) & 0xff]++] = src[i];
+		}
+
+		std::swap(src, dst);
+	}
+
+	if (src != m_sort_entries.data()) {
+		std::copy_n(src, count, m_sort_entries.data());
+	}
+}
+
+void RenderBatcher::_rotate_elements(u32 first, u32 middle, u32 last) {
+	// NOTE: Rotate in place since we don't want the vector's size to change
+	if (m_settings.indexed) {
+		auto begin = m_indices.begin();
+		std::rotate(begin + first, begin + middle, begin + last);
+	} else {
+		_visit_vertices([&](auto& arena) {
+			auto begin = arena.begin();
+			std::rotate(begin + first, begin + middle, begin + last);
+		});
+	}
+}
+
+void RenderBatcher::_chain_index_range(DrawCommand& draw, u32 first, u32 count) {
+	// Contiguous ranges are extended in place
+	if (draw.index_range == 0) {
+		if (draw.element_idx + draw.element_count == first) {
+			return;
+		}
+
+		m_index_ranges.push_back(IndexRange { draw.element_idx, draw.element_count, 0 });
+		draw.index_range = m_index_ranges.size();
+	} else {
+		IndexRange& last = m_index_ranges[draw.index_range - 1];
+		if (last.first + last.count == first) {
+			last.count += count;
+			return;
+		}
+	}
+
+	m_index_ranges.push_back(IndexRange { first, count, draw.index_range });
+	draw.index_range = m_index_ranges.size();
+}
+
+u32 RenderBatcher::_gather_indices(u32 command_count) {
+	u32 index_count = 0;
+
+	for (u32 i = 0; i < command_count; i += 1) {
+		DrawCommand& draw = m_commands[i].args.draw;
+
+		// Retained geometry keeps indexing its own buffers
+		if (m_commands[i].type != BatchCommandType::Draw
+			|| draw.vertex_buf.id != SG_INVALID_ID) {
+			continue;
+		}
+
+		u32 end = index_count + draw.element_count;
+		if (draw.index_range == 0) {
+			std::copy_n(
+				m_indices.begin() + draw.element_idx, draw.element_count,
+				m_sorted_indices.begin() + index_count
+			);
+		} else {
+			// Ranges link backward, so they're laid out from the end
+			u32 dst = end;
+			for (u32 r = draw.index_range; r != 0; r = m_index_ranges[r - 1].prev) {
+				const IndexRange& range = m_index_ranges[r - 1];
+				dst -= range.count;
+				std::copy_n(
+					m_indices.begin() + range.first, range.count,
+					m_sorted_indices.begin() + dst
+				);
+			}
+			assert(dst == index_count);
+			draw.index_range = 0;
+		}
+
+		draw.element_idx = index_count;
+		index_count = end;
+	}
+
+	m_indices.swap(m_sorted_indices);
+	m_index_ranges.clear();
+	return index_count;
+}
+
+u32 RenderBatcher::_vertex_capacity() const {
+	return _visit_vertices([](const auto& arena) { return (u32)arena.size(); });
+}
+
+usize RenderBatcher::_vertex_stride() const {
+	return _visit_vertices([](const auto& arena) {
+		return sizeof(typename std::decay_t<decltype(arena)>::value_type);
+	});
+}
+
+const u8 *RenderBatcher::_vertex_data() const {
+	return _visit_vertices([](const auto& arena) { return (const u8 *)arena.data(); });
+}
+
+template <typename V>
+std::span<V> RenderBatcher::_get_vertices(std::vector<V>& arena, u32 count) {
+	if (m_cur_vertex + count >= arena.capacity()) {
 		vt::log::error("[GFX] | RenderBatcher > Vertex buffer overflow");
-		return std::span<Vertex> {};
+		m_frame_stats.overflow_drops += 1;
+		return std::span<V> {};
 	}
 
-	std::span<Vertex> vertices { m_vertices.begin() + m_cur_vertex, count };
+	std::span<V> vertices { arena.begin() + m_cur_vertex, count };
 	m_cur_vertex += count;
 	return vertices;
 }
 
+u8 RenderBatcher::_get_texture_slot(const Texture& texture) {
+	if (!m_texture_groups.empty()) {
+		TextureGroup& group = m_texture_groups.back();
+		for (u32 slot = 0; slot < group.count; slot += 1) {
+			if (group.textures[slot] == texture) {
+				return slot;
+			}
+		}
+
+		if (group.count < MAX_TEXTURES_SLOTS) {
+			group.textures[group.count] = texture;
+			return group.count++;
+		}
+	}
+
+	// Every slot is taken, later draws won't merge with the previous ones
+	TextureGroup& group = m_texture_groups.emplace_back();
+	group.textures.fill(make_common_texture());
+	group.textures[0] = texture;
+	group.count = 1;
+	return 0;
+}
+
+void RenderBatcher::_assign_texture_slot(
+	DrawCommand& draw, u32 vertex_idx, u32 vertex_count
+) {
+	// Custom pipelines sample their textures as they see fit
+	if (m_settings.vertex_format != VertexFormat::MultiTexture
+		|| draw.pipeline.id != SG_INVALID_ID) {
+		return;
+	}
+
+	// The common shader only samples the first texture
+	const Texture& texture = draw.textures[0].img.id != SG_INVALID_ID
+							   ? draw.textures[0]
+							   : make_common_texture();
+	u8 slot = _get_texture_slot(texture);
+
+	draw.textures = TexturesUniform {};
+	draw.texture_group = m_texture_groups.size();
+
+	auto vertices = std::span(m_multi_vertices).subspan(vertex_idx, vertex_count);
+	for (auto& vertex : vertices) {
+		vertex.texture_slot = slot;
+	}
+}
+
+std::span<u16> RenderBatcher::_get_indices(u32 count) {
+	if (m_cur_index + count >= m_indices.capacity()) {
+		vt::log::error("[GFX] | RenderBatcher > Index buffer overflow");
+		m_frame_stats.overflow_drops += 1;
+		return std::span<u16> {};
+	}
+
+	std::span<u16> indices { m_indices.begin() + m_cur_index, count };
+	m_cur_index += count;
+	return indices;
+}
+
+std::span<SpriteInstance> RenderBatcher::_get_instances(u32 count) {
+	if (m_cur_instance + count > m_instances.capacity()) {
+		vt::log::error("[GFX] | RenderBatcher > Instance buffer overflow");
+		m_frame_stats.overflow_drops += 1;
+		return std::span<SpriteInstance> {};
+	}
+
+	std::span<SpriteInstance> instances { m_instances.begin() + m_cur_instance, count };
+	m_cur_instance += count;
+	return instances;
+}
+
+UniformBuffer RenderBatcher::_push_uniform(std::span<const u8> data) {
+	if (data.empty()) {
+		return UniformBuffer {};
+	}
+
+	assert(data.size() <= UINT16_MAX);
+
+	// FNV-1a over the block
+	u64 hash = 14695981039346656037ull;
+	for (u8 byte : data) {
+		hash = (hash ^ byte) * 1099511628211ull;
+	}
+
+	UniformSlot *free_slot = nullptr;
+	for (u32 probe = 0; probe < _UNIFORM_CACHE_SIZE; probe += 1) {
+		UniformSlot& slot = m_uniform_cache[(hash + probe) & (_UNIFORM_CACHE_SIZE - 1)];
+		if (slot.uniform.size == 0) {
+			free_slot = &slot;
+			break;
+		}
+
+		// Reuse the identical block already written this frame
+		const u8 *block = m_uniform_buffer.data() + slot.uniform.offset;
+		if (slot.hash == hash && slot.uniform.size == data.size()
+			&& std::memcmp(block, data.data(), data.size()) == 0) {
+			return slot.uniform;
+		}
+	}
+
+	// Uniforms are never uploaded as a whole, so the arena just grows
+	u32 offset = (m_cur_uniform + _UNIFORM_ALIGNMENT - 1) & ~(_UNIFORM_ALIGNMENT - 1);
+	usize end = offset + data.size();
+	if (end > m_uniform_buffer.size()) {
+		m_uniform_buffer.resize(std::max(m_uniform_buffer.size() * 2, end));
+	}
+
+	std::copy(data.begin(), data.end(), m_uniform_buffer.begin() + offset);
+	m_cur_uniform = end;
+
+	UniformBuffer uniform { .offset = offset, .size = (u16)data.size() };
+
+	// Blocks are still written once the cache is full, only not deduplicated
+	if (free_slot) {
+		*free_slot = UniformSlot { .hash = hash, .uniform = uniform };
+	}
+
+	return uniform;
+}
+
 RenderBatcher::BatchCommand *RenderBatcher::_next_command() {
 	if (m_cur_command >= m_commands.capacity()) {
 		vt::log::error("[GFX] | RenderBatcher > Commands array is full");
+		m_frame_stats.overflow_drops += 1;
 		return nullptr;
 	}
 
@@ -523,3 +2044,25 @@ RenderBatcher::BatchCommand *RenderBatcher::_prev_command(u32 depth) {
 
 	return &m_commands[m_cur_command - depth];
 }
+
+void RenderBatcher::_commit_listener(void *usrdata) {
+	auto *batcher = (RenderBatcher *)usrdata;
+
+	// Next frame starts after the buffers this one wrote
+	u32 buffer_count = batcher->m_settings.buffer_count;
+	batcher->m_frame_buffer
+		= (batcher->m_frame_buffer + batcher->m_frame_buffers) % buffer_count;
+	batcher->m_last_frame_buffers = std::exchange(batcher->m_frame_buffers, 0);
+
+	// Rotate frame statistics
+	u32 slot = (batcher->m_stats_frame + 1) % FRAME_STATS_HISTORY;
+	batcher->m_stats_history[slot] = batcher->m_frame_stats;
+	batcher->m_stats_frame = slot;
+	batcher->m_frame_stats = FrameStats {};
+
+	// Captures hold whole frames
+	if (batcher->m_capture) {
+		batcher->m_capture->m_complete = true;
+	}
+	batcher->m_capture = std::exchange(batcher->m_capture_next, nullptr);
+}
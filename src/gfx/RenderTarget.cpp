@@ -0,0 +1,183 @@
+#include "gfx/RenderTarget.hpp"
+
+#include "log.hpp"
+
+using namespace vt;
+
+bool RenderTarget::create(const RenderTargetDesc& desc) {
+	assert(!is_valid());
+	assert(desc.width > 0 && desc.height > 0);
+
+	m_desc = desc;
+	if (m_desc.sample_count == 0) {
+		m_desc.sample_count = 1;
+	}
+
+	sg_image_desc image {};
+	image.usage.render_attachment = true;
+	image.width = m_desc.width;
+	image.height = m_desc.height;
+	image.pixel_format = m_desc.color_format;
+	image.sample_count = m_desc.sample_count;
+	image.label = "vt_render_target.color_image";
+	m_color_img = sg_make_image(&image);
+
+	sg_attachments_desc attachments {};
+	attachments.colors[0].image = m_color_img;
+
+	// Multisampled images can't be sampled, they're resolved into another one
+	if (m_desc.sample_count > 1) {
+		image.sample_count = 1;
+		image.label = "vt_render_target.resolve_image";
+		m_resolve_img = sg_make_image(&image);
+		attachments.resolves[0].image = m_resolve_img;
+	}
+
+	if (m_desc.depth_format != SG_PIXELFORMAT_NONE) {
+		image.pixel_format = m_desc.depth_format == _SG_PIXELFORMAT_DEFAULT
+							   ? sg_query_desc().environment.defaults.depth_format
+							   : m_desc.depth_format;
+		image.sample_count = m_desc.sample_count;
+		image.label = "vt_render_target.depth_image";
+		m_depth_img = sg_make_image(&image);
+		attachments.depth_stencil.image = m_depth_img;
+	}
+
+	attachments.label = "vt_render_target.attachments";
+	m_attachments = sg_make_attachments(&attachments);
+	if (sg_query_attachments_state(m_attachments) != SG_RESOURCESTATE_VALID) {
+		vt::log::error(
+			"[GFX] | RenderTarget > Failed to make a {}x{} target", m_desc.width,
+			m_desc.height
+		);
+		destroy();
+		return false;
+	}
+
+	return true;
+}
+
+void RenderTarget::destroy() {
+	sg_destroy_attachments(m_attachments);
+	sg_destroy_image(m_color_img);
+	sg_destroy_image(m_resolve_img);
+	sg_destroy_image(m_depth_img);
+
+	m_attachments.id = SG_INVALID_ID;
+	m_color_img.id = SG_INVALID_ID;
+	m_resolve_img.id = SG_INVALID_ID;
+	m_depth_img.id = SG_INVALID_ID;
+}
+
+[[nodiscard]] bool RenderTarget::is_valid() const {
+	return m_attachments.id != SG_INVALID_ID;
+}
+
+[[nodiscard]] const RenderTargetDesc& RenderTarget::get_desc() const {
+	return m_desc;
+}
+
+[[nodiscard]] Point RenderTarget::get_size() const {
+	return Point { m_desc.width, m_desc.height };
+}
+
+[[nodiscard]] sg_attachments RenderTarget::get_attachments() const {
+	return m_attachments;
+}
+
+[[nodiscard]] Texture RenderTarget::get_texture() const {
+	return Texture {
+		.img = m_resolve_img.id != SG_INVALID_ID ? m_resolve_img : m_color_img,
+		.smp = make_common_texture().smp,
+	};
+}
+
+bool RenderTargetPool::init() {
+	// Released targets become available again once a frame is committed
+	if (!sg_add_commit_listener({ _commit_listener, this })) {
+		vt::log::error("[GFX] | RenderTargetPool > Failed to add commit listener");
+		return false;
+	}
+
+	m_is_valid = true;
+	return true;
+}
+
+void RenderTargetPool::terminate() {
+	sg_remove_commit_listener({ _commit_listener, this });
+
+	for (auto& entry : m_entries) {
+		entry.target.destroy();
+	}
+	m_entries.clear();
+
+	m_is_valid = false;
+}
+
+RenderTarget RenderTargetPool::acquire(const RenderTargetDesc& desc) {
+	assert(m_is_valid);
+
+	RenderTargetDesc key = desc;
+	if (key.sample_count == 0) {
+		key.sample_count = 1;
+	}
+
+	for (auto& entry : m_entries) {
+		if (!entry.acquired && entry.released_frame < m_frame
+			&& entry.target.get_desc() == key) {
+			entry.acquired = true;
+			return entry.target;
+		}
+	}
+
+	RenderTarget target;
+	if (!target.create(key)) {
+		return RenderTarget {};
+	}
+
+	m_entries.push_back(PoolEntry {
+		.target = target,
+		.released_frame = 0,
+		.acquired = true,
+	});
+	return target;
+}
+
+void RenderTargetPool::release(const RenderTarget& target) {
+	assert(m_is_valid);
+
+	sg_attachments attachments = target.get_attachments();
+	for (auto& entry : m_entries) {
+		if (entry.target.get_attachments().id == attachments.id) {
+			assert(entry.acquired);
+			entry.acquired = false;
+			entry.released_frame = m_frame;
+			return;
+		}
+	}
+
+	vt::log::warn("[GFX] | RenderTargetPool > Released a target it doesn't own");
+}
+
+[[nodiscard]] u32 RenderTargetPool::get_target_count() const {
+	return m_entries.size();
+}
+
+void RenderTargetPool::_commit_listener(void *usrdata) {
+	auto *pool = (RenderTargetPool *)usrdata;
+	pool->m_frame += 1;
+
+	// Drop targets left unused, like those of a previous window size
+	auto& entries = pool->m_entries;
+	for (usize i = 0; i < entries.size();) {
+		PoolEntry& entry = entries[i];
+		if (entry.acquired || entry.released_frame + _MAX_IDLE_FRAMES >= pool->m_frame) {
+			i += 1;
+			continue;
+		}
+
+		entry.target.destroy();
+		entry = entries.back();
+		entries.pop_back();
+	}
+}
@@ -0,0 +1,82 @@
+#include "gfx/ShaderWatcher.hpp"
+
+#include "gfx/common.hpp"
+#include "log.hpp"
+
+#include <string_view>
+
+#if VT_HOT_RELOAD_SHADERS
+#	include <sys/inotify.h>
+#	include <unistd.h>
+#endif
+
+using namespace vt;
+
+bool ShaderWatcher::init() {
+#if VT_HOT_RELOAD_SHADERS
+	m_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	if (m_fd < 0) {
+		vt::log::error("[GFX] | ShaderWatcher > Failed to initialize inotify");
+		return false;
+	}
+
+	// Editors often save by moving a new file over the old one, which would end
+	// a watch on the file itself
+	if (inotify_add_watch(m_fd, VT_SHADER_DIR, IN_CLOSE_WRITE | IN_MOVED_TO) < 0) {
+		vt::log::error("[GFX] | ShaderWatcher > Failed to watch '{}'", VT_SHADER_DIR);
+		terminate();
+		return false;
+	}
+
+	vt::log::info("[GFX] | ShaderWatcher > Watching '{}'", VT_SHADER_DIR);
+#endif
+	return true;
+}
+
+void ShaderWatcher::terminate() {
+#if VT_HOT_RELOAD_SHADERS
+	if (m_fd >= 0) {
+		close(m_fd);
+	}
+#endif
+	m_fd = -1;
+}
+
+u32 ShaderWatcher::poll() {
+	u32 reloaded = 0;
+
+#if VT_HOT_RELOAD_SHADERS
+	if (m_fd < 0) {
+		return 0;
+	}
+
+	alignas(inotify_event) char buffer[4096];
+	for (;;) {
+		// Non-blocking, fails once every event is read
+		ssize_t size = read(m_fd, buffer, sizeof(buffer));
+		if (size <= 0) {
+			break;
+		}
+
+		for (ssize_t offset = 0; offset < size;) {
+			const auto *event = (const inotify_event *)(buffer + offset);
+			offset += sizeof(inotify_event) + event->len;
+			if (event->len == 0) {
+				continue;
+			}
+
+			// `<name>.vert.glsl` and `<name>.frag.glsl` both belong to `<name>`
+			std::string_view file { event->name };
+			for (std::string_view suffix : { ".vert.glsl", ".frag.glsl" }) {
+				if (file.ends_with(suffix)) {
+					file.remove_suffix(suffix.size());
+					reloaded += vt::reload_shader(file) ? 1 : 0;
+					break;
+				}
+			}
+		}
+	}
+#endif
+
+	return reloaded;
+}
@@ -0,0 +1,130 @@
+#include "gfx/StaticBatch.hpp"
+
+#include "gfx/Drawable.hpp"
+#include "gfx/kernels.hpp"
+#include "log.hpp"
+
+#include <algorithm>
+
+using namespace vt;
+
+void StaticBatch::add(const Drawable& drawable) {
+	assert(!is_baked());
+
+	if (drawable.m_vertices.empty()) {
+		return;
+	}
+
+	u32 base_vertex = m_vertices.size();
+	u32 vertex_count = drawable.m_vertices.size();
+	m_vertices.resize(base_vertex + vertex_count);
+
+	// Vertices are baked in world space, the view is applied when drawn
+	std::span<Vertex> vertices { m_vertices.begin() + base_vertex, vertex_count };
+	Rect bounds = kernels::transform_vertices(
+		drawable.get_matrix(), drawable.m_vertices, nullptr, vertices
+	);
+
+	// Indices are always used, so every primitive shares the same pipelines
+	const auto& local_indices = drawable.m_indices;
+	u32 index_idx = m_indices.size();
+	u32 index_count = local_indices.empty() ? vertex_count : local_indices.size();
+	m_indices.resize(index_idx + index_count);
+	for (u32 i = 0; i < index_count; i += 1) {
+		u32 index = local_indices.empty() ? i : local_indices[i];
+		m_indices[index_idx + i] = base_vertex + index;
+	}
+
+	sg_primitive_type primitive = drawable.m_primitive;
+	bool mergeable = primitive != SG_PRIMITIVETYPE_LINE_STRIP
+				  && primitive != SG_PRIMITIVETYPE_TRIANGLE_STRIP;
+
+	// Consecutive drawables sharing state become a single command
+	if (!m_commands.empty() && mergeable) {
+		StaticCommand& prev = m_commands.back();
+		if (prev.primitive == primitive && prev.textures == drawable.m_textures) {
+			prev.index_count += index_count;
+			prev.bounds.x1 = std::min(prev.bounds.x1, bounds.x1);
+			prev.bounds.y1 = std::min(prev.bounds.y1, bounds.y1);
+			prev.bounds.x2 = std::max(prev.bounds.x2, bounds.x2);
+			prev.bounds.y2 = std::max(prev.bounds.y2, bounds.y2);
+			return;
+		}
+	}
+
+	m_commands.push_back(StaticCommand {
+		.bounds = bounds,
+		.textures = drawable.m_textures,
+		.pipeline = {},
+		.primitive = primitive,
+		.index_idx = index_idx,
+		.index_count = index_count,
+	});
+}
+
+bool StaticBatch::bake() {
+	assert(!is_baked());
+
+	if (m_vertices.empty()) {
+		return false;
+	}
+
+	for (auto& cmd : m_commands) {
+		cmd.pipeline = vt::make_static_pipeline(cmd.primitive);
+		if (sg_query_pipeline_state(cmd.pipeline) != SG_RESOURCESTATE_VALID) {
+			vt::log::error("[GFX] | StaticBatch > Failed to make static pipeline");
+			return false;
+		}
+	}
+
+	sg_buffer_desc bufdesc {};
+	bufdesc.size = m_vertices.size() * sizeof(Vertex);
+	bufdesc.usage.vertex_buffer = true;
+	bufdesc.data = { m_vertices.data(), bufdesc.size };
+	bufdesc.label = "vt_static_batch.vertex_buffer";
+
+	m_vertex_buf = sg_make_buffer(bufdesc);
+	if (sg_query_buffer_state(m_vertex_buf) != SG_RESOURCESTATE_VALID) {
+		vt::log::error("[GFX] | StaticBatch > Failed to make vertex buffer handler");
+		clear();
+		return false;
+	}
+
+	sg_buffer_desc idxdesc {};
+	idxdesc.size = m_indices.size() * sizeof(u32);
+	idxdesc.usage.index_buffer = true;
+	idxdesc.data = { m_indices.data(), idxdesc.size };
+	idxdesc.label = "vt_static_batch.index_buffer";
+
+	m_index_buf = sg_make_buffer(idxdesc);
+	if (sg_query_buffer_state(m_index_buf) != SG_RESOURCESTATE_VALID) {
+		vt::log::error("[GFX] | StaticBatch > Failed to make index buffer handler");
+		clear();
+		return false;
+	}
+
+	// Only the commands are needed from now on
+	m_vertices = {};
+	m_indices = {};
+	return true;
+}
+
+void StaticBatch::clear() {
+	if (sg_query_buffer_state(m_vertex_buf) != SG_RESOURCESTATE_INVALID) {
+		sg_destroy_buffer(m_vertex_buf);
+	}
+
+	if (sg_query_buffer_state(m_index_buf) != SG_RESOURCESTATE_INVALID) {
+		sg_destroy_buffer(m_index_buf);
+	}
+
+	m_vertex_buf = sg_buffer {};
+	m_index_buf = sg_buffer {};
+	m_vertices.clear();
+	m_indices.clear();
+	m_commands.clear();
+}
+
+[[nodiscard]] bool StaticBatch::is_baked() const {
+	return m_vertex_buf.id != SG_INVALID_ID;
+}
@@ -71,6 +71,12 @@ void View::set_zoom(f32 scale) {
 	m_transform = Mat4 {};
 	glm_mat4_ins3(m, m_transform.raw);
 
+	// Move the 2D translation out of the Z axis column
+	m_transform.raw[3][0] = m[2][0];
+	m_transform.raw[3][1] = m[2][1];
+	m_transform.raw[2][0] = 0.0;
+	m_transform.raw[2][1] = 0.0;
+
 	m_update_transform = false;
 	return m_transform;
 }
@@ -1,15 +1,53 @@
 #include "gfx/common.hpp"
+#include "gfx/ProgramCache.hpp"
+#include "log.hpp"
+#include "math/Mat4.hpp"
 
-#include <glad/gl.h>
+#include <algorithm>
+#include <cassert>
+#include <cstdio>
+#include <string>
+#include <vector>
 
+// Headless builds record commands without any GPU behind them
 #define SOKOL_IMPL
-#define SOKOL_GLCORE
-#define SOKOL_EXTERNAL_GL_LOADER
+#if VT_GFX_DUMMY_BACKEND
+#	define SOKOL_DUMMY_BACKEND
+#else
+#	include <glad/gl.h>
+#	define SOKOL_GLCORE
+#	define SOKOL_EXTERNAL_GL_LOADER
+#endif
 #include <sokol/sokol_gfx.h>
 
+struct PipelineSlot {
+	u32 hash;
+	vt::PipelineState state;
+	sg_shader shader;	  // The state's one, builtin ones resolved
+	sg_pipeline pipeline; // Invalid while the slot is free
+};
+
+struct ShaderEntry {
+	std::string name;
+	sg_shader_desc desc;
+	// Read from the files, the sources of `desc` are used while empty
+	std::string vs_source;
+	std::string fs_source;
+	sg_shader shader;
+};
+
 struct GfxResources {
-	sg_pipeline primitive_pips[_SG_PRIMITIVETYPE_NUM];
+	// Open addressing over a power of two, grown at half full
+	std::vector<PipelineSlot> pipeline_slots;
+	// Batchers ask for the same pipeline draw after draw
+	PipelineSlot last_pipeline;
+	vt::PipelineCacheStats pipeline_stats;
+	bool pipelines_prewarmed;
+	std::vector<ShaderEntry> shaders;
 	sg_shader common_shdr;
+	sg_shader multi_texture_shdr;
+	sg_shader instanced_shdr;
+	sg_shader static_shdr;
 	sg_image white_img;
 	sg_sampler nearest_smp;
 };
@@ -39,82 +77,706 @@ static const char _common_fs_source[] =
 	"    out_color = texture(u_tex0, f_uv) * f_color; \n"
 	"}";
 
-sg_pipeline_desc vt::init_pipeline_desc(sg_primitive_type primitive, sg_shader shdr) {
+static_assert(vt::MAX_TEXTURES_SLOTS == 16, "The batching shader samples 16 slots");
+
+static const char _multi_texture_vs_source[] =
+	"#version 410 core    \n"
+	"in vec3 a_pos;       \n"
+	"in vec2 a_uv;        \n"
+	"in vec4 a_color;     \n"
+	"in vec4 a_slot;      \n"
+	"out vec4 f_color;    \n"
+	"out vec2 f_uv;       \n"
+	"flat out int f_slot; \n"
+	"void main() {        \n"
+	"    f_color = a_color;       \n"
+	"    f_uv = a_uv;             \n"
+	"    f_slot = int(a_slot.x);  \n"
+	"    gl_Position = vec4(a_pos, 1.0); \n"
+	"}";
+
+// Derivatives are taken before branching, they are undefined in non-uniform
+// control flow
+static const char _multi_texture_fs_source[] =
+	"#version 410 core             \n"
+	"uniform sampler2D u_tex[16];  \n"
+	"in vec4 f_color;              \n"
+	"in vec2 f_uv;                 \n"
+	"flat in int f_slot;           \n"
+	"out vec4 out_color;           \n"
+	"vec4 sample_slot(vec2 dx, vec2 dy) { \n"
+	"    switch (f_slot) {                \n"
+	"    case 0: return textureGrad(u_tex[0], f_uv, dx, dy);   \n"
+	"    case 1: return textureGrad(u_tex[1], f_uv, dx, dy);   \n"
+	"    case 2: return textureGrad(u_tex[2], f_uv, dx, dy);   \n"
+	"    case 3: return textureGrad(u_tex[3], f_uv, dx, dy);   \n"
+	"    case 4: return textureGrad(u_tex[4], f_uv, dx, dy);   \n"
+	"    case 5: return textureGrad(u_tex[5], f_uv, dx, dy);   \n"
+	"    case 6: return textureGrad(u_tex[6], f_uv, dx, dy);   \n"
+	"    case 7: return textureGrad(u_tex[7], f_uv, dx, dy);   \n"
+	"    case 8: return textureGrad(u_tex[8], f_uv, dx, dy);   \n"
+	"    case 9: return textureGrad(u_tex[9], f_uv, dx, dy);   \n"
+	"    case 10: return textureGrad(u_tex[10], f_uv, dx, dy); \n"
+	"    case 11: return textureGrad(u_tex[11], f_uv, dx, dy); \n"
+	"    case 12: return textureGrad(u_tex[12], f_uv, dx, dy); \n"
+	"    case 13: return textureGrad(u_tex[13], f_uv, dx, dy); \n"
+	"    case 14: return textureGrad(u_tex[14], f_uv, dx, dy); \n"
+	"    default: return textureGrad(u_tex[15], f_uv, dx, dy); \n"
+	"    }                                \n"
+	"}                                    \n"
+	"void main() {                        \n"
+	"    out_color = sample_slot(dFdx(f_uv), dFdy(f_uv)) * f_color; \n"
+	"}";
+
+static const char *_multi_texture_names[] = {
+	"u_tex[0]",
+	"u_tex[1]",
+	"u_tex[2]",
+	"u_tex[3]",
+	"u_tex[4]",
+	"u_tex[5]",
+	"u_tex[6]",
+	"u_tex[7]",
+	"u_tex[8]",
+	"u_tex[9]",
+	"u_tex[10]",
+	"u_tex[11]",
+	"u_tex[12]",
+	"u_tex[13]",
+	"u_tex[14]",
+	"u_tex[15]",
+};
+
+static const char _instanced_vs_source[] =
+	"#version 410 core    \n"
+	"uniform mat4 u_mvp;  \n"
+	"in vec3 a_pos;       \n"
+	"in vec2 a_uv;        \n"
+	"in vec4 a_color;     \n"
+	"in vec4 i_basis;     \n"
+	"in vec2 i_origin;    \n"
+	"in vec4 i_uv_rect;   \n"
+	"in vec4 i_color;     \n"
+	"out vec4 f_color;    \n"
+	"out vec2 f_uv;       \n"
+	"void main() {        \n"
+	"    vec2 pos = i_origin + a_pos.x * i_basis.xy + a_pos.y * i_basis.zw; \n"
+	"    f_color = a_color * i_color;               \n"
+	"    f_uv = i_uv_rect.xy + a_uv * i_uv_rect.zw; \n"
+	"    gl_Position = u_mvp * vec4(pos, a_pos.z, 1.0); \n"
+	"}";
+
+static const char _static_vs_source[] =
+	"#version 410 core   \n"
+	"uniform mat4 u_mvp; \n"
+	"in vec3 a_pos;      \n"
+	"in vec2 a_uv;       \n"
+	"in vec4 a_color;    \n"
+	"out vec4 f_color;   \n"
+	"out vec2 f_uv;      \n"
+	"void main() {       \n"
+	"    f_color = a_color; \n"
+	"    f_uv = a_uv;       \n"
+	"    gl_Position = u_mvp * vec4(a_pos, 1.0); \n"
+	"}";
+
+static void _init_sprite_shader_desc(sg_shader_desc& desc) {
+	desc.fragment_func.source = _common_fs_source;
+	desc.fragment_func.entry = "main";
+	desc.attrs[(i32)vt::VertexAttr::Pos].glsl_name = "a_pos";
+	desc.attrs[(i32)vt::VertexAttr::UV].glsl_name = "a_uv";
+	desc.attrs[(i32)vt::VertexAttr::Color].glsl_name = "a_color";
+	desc.images[0].stage = SG_SHADERSTAGE_FRAGMENT;
+	desc.images[0].image_type = SG_IMAGETYPE_2D;
+	desc.images[0].sample_type = SG_IMAGESAMPLETYPE_FLOAT;
+	desc.samplers[0].stage = SG_SHADERSTAGE_FRAGMENT;
+	desc.samplers[0].sampler_type = SG_SAMPLERTYPE_FILTERING;
+	desc.image_sampler_pairs[0].stage = SG_SHADERSTAGE_FRAGMENT;
+	desc.image_sampler_pairs[0].image_slot = 0;
+	desc.image_sampler_pairs[0].sampler_slot = 0;
+	desc.image_sampler_pairs[0].glsl_name = "u_tex0";
+}
+
+static void _init_mvp_uniform_desc(sg_shader_desc& desc) {
+	desc.uniform_blocks[0].stage = SG_SHADERSTAGE_VERTEX;
+	desc.uniform_blocks[0].size = sizeof(vt::Mat4);
+	desc.uniform_blocks[0].glsl_uniforms[0] = {
+		.type = SG_UNIFORMTYPE_MAT4,
+		.array_count = 1,
+		.glsl_name = "u_mvp",
+	};
+}
+
+vt::MultiTextureVertex::MultiTextureVertex(const Vertex& vertex, u8 slot)
+	: position { vertex.position },
+	  texcoord { vertex.texcoord },
+	  color { vertex.color },
+	  texture_slot { slot } { }
+
+vt::CompactVertex::CompactVertex(const Vertex& vertex)
+	: position { vertex.position.x, vertex.position.y }, color { vertex.color } {
+	for (u32 i = 0; i < 2; i += 1) {
+		f32 uv = std::clamp(vertex.texcoord.raw[i], 0.0f, 1.0f);
+		texcoord[i] = (u16)(uv * 65535.0f + 0.5f);
+	}
+}
+
+sg_pipeline_desc vt::init_pipeline_desc(
+	sg_primitive_type primitive,
+	sg_shader shdr,
+	sg_index_type index_type,
+	VertexFormat format
+) {
 	sg_pipeline_desc desc {};
 	desc.shader = shdr;
-	desc.layout.buffers[0].stride = sizeof(vt::Vertex);
-	desc.layout.attrs[(i32)vt::VertexAttr::Pos] = {
-		.buffer_index = 0,
-		.offset = offsetof(vt::Vertex, position),
-		.format = SG_VERTEXFORMAT_FLOAT3,
-	};
-	desc.layout.attrs[(i32)vt::VertexAttr::UV] = {
-		.buffer_index = 0,
-		.offset = offsetof(vt::Vertex, texcoord),
-		.format = SG_VERTEXFORMAT_FLOAT2,
-	};
-	desc.layout.attrs[(i32)vt::VertexAttr::Color] = {
-		.buffer_index = 0,
-		.offset = offsetof(vt::Vertex, color),
-		.format = SG_VERTEXFORMAT_UBYTE4N,
-	};
+
+	// Shaders read the same attributes either way, missing components of the
+	// compact position are filled with a zero depth
+	switch (format) {
+	case VertexFormat::Standard:
+		desc.layout.buffers[0].stride = sizeof(vt::Vertex);
+		desc.layout.attrs[(i32)vt::VertexAttr::Pos] = {
+			.buffer_index = 0,
+			.offset = offsetof(vt::Vertex, position),
+			.format = SG_VERTEXFORMAT_FLOAT3,
+		};
+		desc.layout.attrs[(i32)vt::VertexAttr::UV] = {
+			.buffer_index = 0,
+			.offset = offsetof(vt::Vertex, texcoord),
+			.format = SG_VERTEXFORMAT_FLOAT2,
+		};
+		desc.layout.attrs[(i32)vt::VertexAttr::Color] = {
+			.buffer_index = 0,
+			.offset = offsetof(vt::Vertex, color),
+			.format = SG_VERTEXFORMAT_UBYTE4N,
+		};
+		break;
+	case VertexFormat::Compact:
+		desc.layout.buffers[0].stride = sizeof(vt::CompactVertex);
+		desc.layout.attrs[(i32)vt::VertexAttr::Pos] = {
+			.buffer_index = 0,
+			.offset = offsetof(vt::CompactVertex, position),
+			.format = SG_VERTEXFORMAT_FLOAT2,
+		};
+		desc.layout.attrs[(i32)vt::VertexAttr::UV] = {
+			.buffer_index = 0,
+			.offset = offsetof(vt::CompactVertex, texcoord),
+			.format = SG_VERTEXFORMAT_USHORT2N,
+		};
+		desc.layout.attrs[(i32)vt::VertexAttr::Color] = {
+			.buffer_index = 0,
+			.offset = offsetof(vt::CompactVertex, color),
+			.format = SG_VERTEXFORMAT_UBYTE4N,
+		};
+		break;
+	case VertexFormat::MultiTexture:
+		desc.layout.buffers[0].stride = sizeof(vt::MultiTextureVertex);
+		desc.layout.attrs[(i32)vt::VertexAttr::Pos] = {
+			.buffer_index = 0,
+			.offset = offsetof(vt::MultiTextureVertex, position),
+			.format = SG_VERTEXFORMAT_FLOAT3,
+		};
+		desc.layout.attrs[(i32)vt::VertexAttr::UV] = {
+			.buffer_index = 0,
+			.offset = offsetof(vt::MultiTextureVertex, texcoord),
+			.format = SG_VERTEXFORMAT_FLOAT2,
+		};
+		desc.layout.attrs[(i32)vt::VertexAttr::Color] = {
+			.buffer_index = 0,
+			.offset = offsetof(vt::MultiTextureVertex, color),
+			.format = SG_VERTEXFORMAT_UBYTE4N,
+		};
+		desc.layout.attrs[(i32)vt::VertexAttr::TexSlot] = {
+			.buffer_index = 0,
+			.offset = offsetof(vt::MultiTextureVertex, texture_slot),
+			.format = SG_VERTEXFORMAT_UBYTE4,
+		};
+		break;
+	default: assert(false);
+	}
+
 	desc.primitive_type = primitive;
+	desc.index_type = index_type;
 	desc.label = "vt_gfx_resources.pipeline";
 
 	return desc;
 }
 
-sg_pipeline vt::make_pipeline(sg_primitive_type primitive) {
-	u32 pip_idx = primitive;
-	if (_gfx.primitive_pips[pip_idx].id != SG_INVALID_ID) {
-		return _gfx.primitive_pips[pip_idx];
+void vt::init_draw_pass(sg_pipeline_desc& desc, DrawPass pass) {
+	switch (pass) {
+	case DrawPass::Unsorted: break;
+	case DrawPass::Opaque:
+		desc.depth.compare = SG_COMPAREFUNC_LESS_EQUAL;
+		desc.depth.write_enabled = true;
+		break;
+	case DrawPass::Translucent:
+		desc.depth.compare = SG_COMPAREFUNC_LESS_EQUAL;
+		[[fallthrough]];
+	case DrawPass::Blended: init_blend_mode(desc, BlendMode::Alpha); break;
+	default: assert(false);
+	}
+}
+
+void vt::init_blend_mode(sg_pipeline_desc& desc, BlendMode blend) {
+	sg_blend_state& state = desc.colors[0].blend;
+
+	switch (blend) {
+	case BlendMode::Pass: break;
+	case BlendMode::None: state = sg_blend_state {}; break;
+	case BlendMode::Alpha:
+		state.enabled = true;
+		state.src_factor_rgb = SG_BLENDFACTOR_SRC_ALPHA;
+		state.dst_factor_rgb = SG_BLENDFACTOR_ONE_MINUS_SRC_ALPHA;
+		state.src_factor_alpha = SG_BLENDFACTOR_ONE;
+		state.dst_factor_alpha = SG_BLENDFACTOR_ONE_MINUS_SRC_ALPHA;
+		break;
+	case BlendMode::Premultiplied:
+		state.enabled = true;
+		state.src_factor_rgb = SG_BLENDFACTOR_ONE;
+		state.dst_factor_rgb = SG_BLENDFACTOR_ONE_MINUS_SRC_ALPHA;
+		state.src_factor_alpha = SG_BLENDFACTOR_ONE;
+		state.dst_factor_alpha = SG_BLENDFACTOR_ONE_MINUS_SRC_ALPHA;
+		break;
+	case BlendMode::Additive:
+		state.enabled = true;
+		state.src_factor_rgb = SG_BLENDFACTOR_SRC_ALPHA;
+		state.dst_factor_rgb = SG_BLENDFACTOR_ONE;
+		state.src_factor_alpha = SG_BLENDFACTOR_ZERO;
+		state.dst_factor_alpha = SG_BLENDFACTOR_ONE;
+		break;
+	case BlendMode::Multiply:
+		state.enabled = true;
+		state.src_factor_rgb = SG_BLENDFACTOR_DST_COLOR;
+		state.dst_factor_rgb = SG_BLENDFACTOR_ONE_MINUS_SRC_ALPHA;
+		state.src_factor_alpha = SG_BLENDFACTOR_DST_ALPHA;
+		state.dst_factor_alpha = SG_BLENDFACTOR_ONE_MINUS_SRC_ALPHA;
+		break;
+	default: assert(false);
+	}
+}
+
+static u32 _hash_pipeline_state(const vt::PipelineState& state) {
+	// FNV-1a over every field of the state
+	u32 hash = 2166136261u;
+	auto mix = [&hash](u32 value) {
+		hash = (hash ^ value) * 16777619u;
+	};
+
+	mix(state.shader.id);
+	mix(state.primitive);
+	mix(state.index_type);
+	mix((u32)state.format);
+	mix((u32)state.pass);
+	mix((u32)state.blend);
+	mix(state.cull_mode);
+	mix(state.instanced);
+
+	return hash;
+}
+
+static PipelineSlot *_find_pipeline_slot(const vt::PipelineState& state, u32 hash) {
+	auto& slots = _gfx.pipeline_slots;
+	if (slots.empty()) {
+		return nullptr;
 	}
 
-	sg_shader shdr = vt::make_common_shader();
+	// Linear probing, the table is never full so a free slot ends the search
+	usize mask = slots.size() - 1;
+	for (usize i = hash & mask;; i = (i + 1) & mask) {
+		PipelineSlot& slot = slots[i];
+		if (slot.pipeline.id == SG_INVALID_ID
+			|| (slot.hash == hash && slot.state == state)) {
+			return &slot;
+		}
+	}
+}
+
+static void _insert_pipeline(const PipelineSlot& entry) {
+	auto& slots = _gfx.pipeline_slots;
+	if ((_gfx.pipeline_stats.pipelines + 1) * 2 > slots.size()) {
+		std::vector<PipelineSlot> old = std::move(slots);
+		slots.assign(std::max<usize>(old.size() * 2, 64), PipelineSlot {});
+
+		for (const auto& slot : old) {
+			if (slot.pipeline.id != SG_INVALID_ID) {
+				*_find_pipeline_slot(slot.state, slot.hash) = slot;
+			}
+		}
+	}
+
+	*_find_pipeline_slot(entry.state, entry.hash) = entry;
+	_gfx.pipeline_stats.pipelines += 1;
+}
 
-	sg_pipeline_desc pipdesc = init_pipeline_desc(primitive, shdr);
+static sg_shader _get_state_shader(const vt::PipelineState& state) {
+	if (state.shader.id != SG_INVALID_ID) {
+		return state.shader;
+	}
+
+	// Multi-texture vertices are meant for the batching shader
+	if (state.instanced) {
+		return vt::make_instanced_shader();
+	} else if (state.format == vt::VertexFormat::MultiTexture) {
+		return vt::make_multi_texture_shader();
+	}
+
+	return vt::make_common_shader();
+}
+
+static sg_pipeline_desc _init_state_desc(const vt::PipelineState& state, sg_shader shdr) {
+	sg_pipeline_desc pipdesc = vt::init_pipeline_desc(
+		state.primitive, shdr, state.index_type, state.format
+	);
+	vt::init_draw_pass(pipdesc, state.pass);
+	vt::init_blend_mode(pipdesc, state.blend);
+	pipdesc.cull_mode = state.cull_mode;
+
+	if (state.instanced) {
+		pipdesc.layout.buffers[1].stride = sizeof(vt::SpriteInstance);
+		pipdesc.layout.buffers[1].step_func = SG_VERTEXSTEP_PER_INSTANCE;
+		pipdesc.layout.attrs[(i32)vt::InstanceAttr::Basis] = {
+			.buffer_index = 1,
+			.offset = offsetof(vt::SpriteInstance, axis_x),
+			.format = SG_VERTEXFORMAT_FLOAT4,
+		};
+		pipdesc.layout.attrs[(i32)vt::InstanceAttr::Origin] = {
+			.buffer_index = 1,
+			.offset = offsetof(vt::SpriteInstance, origin),
+			.format = SG_VERTEXFORMAT_FLOAT2,
+		};
+		pipdesc.layout.attrs[(i32)vt::InstanceAttr::UVRect] = {
+			.buffer_index = 1,
+			.offset = offsetof(vt::SpriteInstance, uv_rect),
+			.format = SG_VERTEXFORMAT_FLOAT4,
+		};
+		pipdesc.layout.attrs[(i32)vt::InstanceAttr::Color] = {
+			.buffer_index = 1,
+			.offset = offsetof(vt::SpriteInstance, color),
+			.format = SG_VERTEXFORMAT_UBYTE4N,
+		};
+		pipdesc.label = "vt_gfx_resources.instanced_pipeline";
+	}
+
+	return pipdesc;
+}
+
+sg_pipeline vt::get_pipeline(const PipelineState& state) {
+	vt::PipelineCacheStats& stats = _gfx.pipeline_stats;
+
+	PipelineSlot& last = _gfx.last_pipeline;
+	if (last.pipeline.id != SG_INVALID_ID && last.state == state) {
+		stats.hits += 1;
+		return last.pipeline;
+	}
+
+	u32 hash = _hash_pipeline_state(state);
+	PipelineSlot *slot = _find_pipeline_slot(state, hash);
+	if (slot && slot->pipeline.id != SG_INVALID_ID) {
+		stats.hits += 1;
+		last = *slot;
+		return slot->pipeline;
+	}
+
+	stats.misses += 1;
+	if (_gfx.pipelines_prewarmed) {
+		stats.late_misses += 1;
+		vt::log::warn("[GFX] | Pipelines > Made a pipeline that wasn't prewarmed");
+	}
+
+	sg_shader shdr = _get_state_shader(state);
+	sg_pipeline_desc pipdesc = _init_state_desc(state, shdr);
+
+	// Failed pipelines aren't cached, they are tried again on the next use
 	sg_pipeline pip = sg_make_pipeline(&pipdesc);
 	if (sg_query_pipeline_state(pip) != SG_RESOURCESTATE_VALID) {
 		sg_destroy_pipeline(pip);
 		return sg_pipeline { SG_INVALID_ID };
 	}
 
-	_gfx.primitive_pips[pip_idx] = pip;
+	PipelineSlot entry { .hash = hash, .state = state, .shader = shdr, .pipeline = pip };
+	_insert_pipeline(entry);
+	last = entry;
 	return pip;
 }
 
+u32 vt::prewarm_pipelines(std::span<const PipelineState> states) {
+	u32 valid = 0;
+	for (const auto& state : states) {
+		if (get_pipeline(state).id != SG_INVALID_ID) {
+			valid += 1;
+		}
+	}
+
+	_gfx.pipelines_prewarmed = true;
+	return valid;
+}
+
+[[nodiscard]] const vt::PipelineCacheStats& vt::get_pipeline_cache_stats() {
+	return _gfx.pipeline_stats;
+}
+
+sg_pipeline vt::make_pipeline(
+	sg_primitive_type primitive,
+	sg_index_type index_type,
+	VertexFormat format,
+	DrawPass pass
+) {
+	return get_pipeline(PipelineState {
+		.primitive = primitive,
+		.index_type = index_type,
+		.format = format,
+		.pass = pass,
+	});
+}
+
+sg_pipeline vt::make_instanced_pipeline(
+	sg_primitive_type primitive,
+	sg_index_type index_type,
+	VertexFormat format,
+	DrawPass pass
+) {
+	return get_pipeline(PipelineState {
+		.primitive = primitive,
+		.index_type = index_type,
+		.format = format,
+		.pass = pass,
+		.instanced = true,
+	});
+}
+
+sg_pipeline vt::make_static_pipeline(sg_primitive_type primitive, DrawPass pass) {
+	return get_pipeline(PipelineState {
+		.shader = make_static_shader(),
+		.primitive = primitive,
+		.index_type = SG_INDEXTYPE_UINT32,
+		.pass = pass,
+	});
+}
+
+static bool _read_file(const std::string& path, std::string& out) {
+	std::FILE *file = std::fopen(path.c_str(), "rb");
+	if (!file) {
+		return false;
+	}
+
+	std::string content;
+	char buffer[4096];
+	usize read = 0;
+	while ((read = std::fread(buffer, 1, sizeof(buffer), file)) > 0) {
+		content.append(buffer, read);
+	}
+
+	bool failed = std::ferror(file);
+	std::fclose(file);
+	if (failed) {
+		return false;
+	}
+
+	out = std::move(content);
+	return true;
+}
+
+static bool _read_shader_sources(ShaderEntry& entry) {
+	std::string path = std::string(VT_SHADER_DIR) + "/" + entry.name;
+	std::string vs_source;
+	std::string fs_source;
+
+	// Both or neither, so a shader never mixes files with embedded sources
+	if (!_read_file(path + ".vert.glsl", vs_source)
+		|| !_read_file(path + ".frag.glsl", fs_source)) {
+		return false;
+	}
+
+	entry.vs_source = std::move(vs_source);
+	entry.fs_source = std::move(fs_source);
+	return true;
+}
+
+static sg_shader_desc _get_shader_desc(const ShaderEntry& entry) {
+	sg_shader_desc desc = entry.desc;
+	if (!entry.vs_source.empty()) {
+		desc.vertex_func.source = entry.vs_source.c_str();
+		desc.fragment_func.source = entry.fs_source.c_str();
+	}
+
+	return desc;
+}
+
+sg_shader vt::load_shader(const char *name, const sg_shader_desc& desc) {
+	for (const auto& entry : _gfx.shaders) {
+		if (entry.name == name) {
+			return entry.shader;
+		}
+	}
+
+	ShaderEntry entry {};
+	entry.name = name;
+	entry.desc = desc;
+	if (!_read_shader_sources(entry)) {
+		vt::log::info("[GFX] | Shaders > Using the embedded sources of '{}'", name);
+	}
+
+	// Kept even if it failed, a reload may fix it
+	sg_shader_desc loaded = _get_shader_desc(entry);
+	entry.shader = vt::program_cache::make_shader(loaded);
+	if (sg_query_shader_state(entry.shader) != SG_RESOURCESTATE_VALID) {
+		vt::log::error("[GFX] | Shaders > Failed to compile '{}'", name);
+	}
+
+	_gfx.shaders.push_back(std::move(entry));
+	return _gfx.shaders.back().shader;
+}
+
+bool vt::reload_shader(std::string_view name) {
+	auto& shaders = _gfx.shaders;
+	auto it = std::find_if(shaders.begin(), shaders.end(), [&](const ShaderEntry& entry) {
+		return entry.name == name;
+	});
+	if (it == shaders.end()) {
+		return false;
+	}
+
+	ShaderEntry& entry = *it;
+	std::string prev_vs = entry.vs_source;
+	std::string prev_fs = entry.fs_source;
+	if (!_read_shader_sources(entry)) {
+		vt::log::warn("[GFX] | Shaders > Failed to read the sources of '{}'", name);
+		return false;
+	}
+
+	sg_shader_desc desc = _get_shader_desc(entry);
+	sg_uninit_shader(entry.shader);
+	vt::program_cache::init_shader(entry.shader, desc);
+
+	bool changed = sg_query_shader_state(entry.shader) == SG_RESOURCESTATE_VALID;
+	if (!changed) {
+		vt::log::error(
+			"[GFX] | Shaders > Failed to compile '{}', keeping the previous sources", name
+		);
+		entry.vs_source = std::move(prev_vs);
+		entry.fs_source = std::move(prev_fs);
+		desc = _get_shader_desc(entry);
+		sg_uninit_shader(entry.shader);
+		vt::program_cache::init_shader(entry.shader, desc);
+	}
+
+	// Pipelines keep referring to the shader they were made with, so they're
+	// made again on the same handles along with it
+	for (const auto& slot : _gfx.pipeline_slots) {
+		if (slot.pipeline.id == SG_INVALID_ID || slot.shader.id != entry.shader.id) {
+			continue;
+		}
+
+		sg_pipeline_desc pipdesc = _init_state_desc(slot.state, slot.shader);
+		sg_uninit_pipeline(slot.pipeline);
+		sg_init_pipeline(slot.pipeline, &pipdesc);
+	}
+
+	if (changed) {
+		vt::log::info("[GFX] | Shaders > Reloaded '{}'", name);
+	}
+
+	return changed;
+}
+
 sg_shader vt::make_common_shader() {
-	if (sg_query_shader_state(_gfx.common_shdr) == SG_RESOURCESTATE_VALID) {
+	if (_gfx.common_shdr.id != SG_INVALID_ID) {
 		return _gfx.common_shdr;
 	}
 
 	sg_shader_desc desc {};
+	_init_sprite_shader_desc(desc);
 	desc.vertex_func.source = _common_vs_source;
 	desc.vertex_func.entry = "main";
-	desc.fragment_func.source = _common_fs_source;
+	desc.label = "vt_gfx_resources.shader";
+
+	_gfx.common_shdr = vt::load_shader("common", desc);
+	return _gfx.common_shdr;
+}
+
+sg_shader vt::make_multi_texture_shader() {
+	if (sg_query_shader_state(_gfx.multi_texture_shdr) == SG_RESOURCESTATE_VALID) {
+		return _gfx.multi_texture_shdr;
+	}
+
+	sg_shader_desc desc {};
+	desc.vertex_func.source = _multi_texture_vs_source;
+	desc.vertex_func.entry = "main";
+	desc.fragment_func.source = _multi_texture_fs_source;
 	desc.fragment_func.entry = "main";
 	desc.attrs[(i32)vt::VertexAttr::Pos].glsl_name = "a_pos";
 	desc.attrs[(i32)vt::VertexAttr::UV].glsl_name = "a_uv";
 	desc.attrs[(i32)vt::VertexAttr::Color].glsl_name = "a_color";
-	desc.images[0].stage = SG_SHADERSTAGE_FRAGMENT;
-	desc.images[0].image_type = SG_IMAGETYPE_2D;
-	desc.images[0].sample_type = SG_IMAGESAMPLETYPE_FLOAT;
-	desc.samplers[0].stage = SG_SHADERSTAGE_FRAGMENT;
-	desc.samplers[0].sampler_type = SG_SAMPLERTYPE_FILTERING;
-	desc.image_sampler_pairs[0].stage = SG_SHADERSTAGE_FRAGMENT;
-	desc.image_sampler_pairs[0].image_slot = 0;
-	desc.image_sampler_pairs[0].sampler_slot = 0;
-	desc.image_sampler_pairs[0].glsl_name = "u_tex0";
-	desc.label = "vt_gfx_resources.shader";
+	desc.attrs[(i32)vt::VertexAttr::TexSlot].glsl_name = "a_slot";
+	for (u32 slot = 0; slot < vt::MAX_TEXTURES_SLOTS; slot += 1) {
+		desc.images[slot].stage = SG_SHADERSTAGE_FRAGMENT;
+		desc.images[slot].image_type = SG_IMAGETYPE_2D;
+		desc.images[slot].sample_type = SG_IMAGESAMPLETYPE_FLOAT;
+		desc.samplers[slot].stage = SG_SHADERSTAGE_FRAGMENT;
+		desc.samplers[slot].sampler_type = SG_SAMPLERTYPE_FILTERING;
+		desc.image_sampler_pairs[slot].stage = SG_SHADERSTAGE_FRAGMENT;
+		desc.image_sampler_pairs[slot].image_slot = slot;
+		desc.image_sampler_pairs[slot].sampler_slot = slot;
+		desc.image_sampler_pairs[slot].glsl_name = _multi_texture_names[slot];
+	}
+	desc.label = "vt_gfx_resources.multi_texture_shader";
 
-	sg_shader shdr = sg_make_shader(&desc);
+	sg_shader shdr = vt::program_cache::make_shader(desc);
 	if (sg_query_shader_state(shdr) != SG_RESOURCESTATE_VALID) {
 		sg_destroy_shader(shdr);
 		shdr.id = SG_INVALID_ID;
 	}
 
-	_gfx.common_shdr = shdr;
-	return _gfx.common_shdr;
+	_gfx.multi_texture_shdr = shdr;
+	return _gfx.multi_texture_shdr;
+}
+
+sg_shader vt::make_instanced_shader() {
+	if (sg_query_shader_state(_gfx.instanced_shdr) == SG_RESOURCESTATE_VALID) {
+		return _gfx.instanced_shdr;
+	}
+
+	sg_shader_desc desc {};
+	_init_sprite_shader_desc(desc);
+	desc.vertex_func.source = _instanced_vs_source;
+	desc.vertex_func.entry = "main";
+	desc.attrs[(i32)vt::InstanceAttr::Basis].glsl_name = "i_basis";
+	desc.attrs[(i32)vt::InstanceAttr::Origin].glsl_name = "i_origin";
+	desc.attrs[(i32)vt::InstanceAttr::UVRect].glsl_name = "i_uv_rect";
+	desc.attrs[(i32)vt::InstanceAttr::Color].glsl_name = "i_color";
+	_init_mvp_uniform_desc(desc);
+	desc.label = "vt_gfx_resources.instanced_shader";
+
+	sg_shader shdr = vt::program_cache::make_shader(desc);
+	if (sg_query_shader_state(shdr) != SG_RESOURCESTATE_VALID) {
+		sg_destroy_shader(shdr);
+		shdr.id = SG_INVALID_ID;
+	}
+
+	_gfx.instanced_shdr = shdr;
+	return _gfx.instanced_shdr;
+}
+
+sg_shader vt::make_static_shader() {
+	if (sg_query_shader_state(_gfx.static_shdr) == SG_RESOURCESTATE_VALID) {
+		return _gfx.static_shdr;
+	}
+
+	sg_shader_desc desc {};
+	_init_sprite_shader_desc(desc);
+	_init_mvp_uniform_desc(desc);
+	desc.vertex_func.source = _static_vs_source;
+	desc.vertex_func.entry = "main";
+	desc.label = "vt_gfx_resources.static_shader";
+
+	sg_shader shdr = vt::program_cache::make_shader(desc);
+	if (sg_query_shader_state(shdr) != SG_RESOURCESTATE_VALID) {
+		sg_destroy_shader(shdr);
+		shdr.id = SG_INVALID_ID;
+	}
+
+	_gfx.static_shdr = shdr;
+	return _gfx.static_shdr;
 }
 
 vt::Texture vt::make_common_texture() {
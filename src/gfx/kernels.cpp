@@ -0,0 +1,400 @@
+#include "gfx/kernels.hpp"
+
+#include <algorithm>
+#include <cfloat>
+#include <cstddef>
+
+#if VT_ARCH_X86_64
+#	include <immintrin.h>
+#endif
+
+#if VT_ARCH_X86_64 && (VT_COMPILER_GCC || VT_COMPILER_CLANG)
+#	define VT_HAS_AVX2_KERNEL 1
+#	define VT_TARGET_AVX2	   __attribute__((target("avx2,fma")))
+#endif
+
+using namespace vt;
+using kernels::Isa;
+
+using TransformFn = Rect (*)(const Mat4&, const Vertex *, const u16 *, Vertex *, u32);
+
+static Rect _transform_scalar(
+	const Mat4& mvp, const Vertex *src, const u16 *indices, Vertex *dst, u32 count
+) {
+	Rect region { FLT_MAX, FLT_MAX, -FLT_MAX, -FLT_MAX };
+
+	for (u32 i = 0; i < count; i += 1) {
+		const Vertex& vertex = src[indices ? indices[i] : i];
+
+		Vec3 position = mvp * vertex.position;
+		dst[i].position = position;
+		dst[i].texcoord = vertex.texcoord;
+		dst[i].color = vertex.color;
+
+		// Update region area the rendering takes
+		region.x1 = std::min(region.x1, position.x);
+		region.y1 = std::min(region.y1, position.y);
+		region.x2 = std::max(region.x2, position.x);
+		region.y2 = std::max(region.y2, position.y);
+	}
+
+	return region;
+}
+
+#if VT_ARCH_X86_64
+// NOTE: Positions are read and written as 16 bytes, spilling into the first
+// texcoord. This never leaves the 24 bytes vertex.
+//
+// Groups of vertices have their positions transposed into x, y and z registers,
+// so every lane works on another vertex, then transposed back to be stored. The
+// first texcoords make the fourth register and are written back unchanged.
+// Draws are mostly quads, so the few vertices left take one register each.
+
+// The second texcoord and the color are copied right away, so only the position
+// and the first texcoord are left to keep around
+static inline __m128 _load_sse2(const Vertex& vertex, Vertex& out) {
+	static_assert(sizeof(Vertex) == 24 && offsetof(Vertex, color) == 20);
+
+	__m128i tail = _mm_loadl_epi64((const __m128i *)&vertex.texcoord.y);
+	_mm_storel_epi64((__m128i *)&out.texcoord.y, tail);
+	return _mm_loadu_ps(vertex.position.raw);
+}
+
+// `row` holds the elements of a matrix row, each one in every lane
+static inline __m128 _dot_sse2(const __m128 row[4], __m128 x, __m128 y, __m128 z) {
+	__m128 xy = _mm_add_ps(_mm_mul_ps(row[0], x), _mm_mul_ps(row[1], y));
+	__m128 zw = _mm_add_ps(_mm_mul_ps(row[2], z), row[3]);
+	return _mm_add_ps(xy, zw);
+}
+
+// Minimum of the x lanes in the first lane and of the y lanes in the second one
+static inline __m128 _fold_min_sse2(__m128 x, __m128 y) {
+	__m128 xy = _mm_min_ps(_mm_unpacklo_ps(x, y), _mm_unpackhi_ps(x, y));
+	return _mm_min_ps(xy, _mm_movehl_ps(xy, xy));
+}
+
+static inline __m128 _fold_max_sse2(__m128 x, __m128 y) {
+	__m128 xy = _mm_max_ps(_mm_unpacklo_ps(x, y), _mm_unpackhi_ps(x, y));
+	return _mm_max_ps(xy, _mm_movehl_ps(xy, xy));
+}
+
+static inline Rect _to_region(__m128 lo, __m128 hi) {
+	alignas(16) f32 min[4];
+	alignas(16) f32 max[4];
+	_mm_store_ps(min, lo);
+	_mm_store_ps(max, hi);
+
+	return Rect { min[0], min[1], max[0], max[1] };
+}
+
+static inline void _transform_one_sse2(
+	const __m128 cols[4], const Vertex& vertex, Vertex& out, __m128& lo, __m128& hi
+) {
+	__m128 pos = _load_sse2(vertex, out);
+	__m128 x = _mm_shuffle_ps(pos, pos, _MM_SHUFFLE(0, 0, 0, 0));
+	__m128 y = _mm_shuffle_ps(pos, pos, _MM_SHUFFLE(1, 1, 1, 1));
+	__m128 z = _mm_shuffle_ps(pos, pos, _MM_SHUFFLE(2, 2, 2, 2));
+
+	__m128 xy = _mm_add_ps(_mm_mul_ps(cols[0], x), _mm_mul_ps(cols[1], y));
+	__m128 zw = _mm_add_ps(_mm_mul_ps(cols[2], z), cols[3]);
+	__m128 result = _mm_add_ps(xy, zw);
+
+	lo = _mm_min_ps(lo, result);
+	hi = _mm_max_ps(hi, result);
+
+	_mm_storeu_ps(out.position.raw, result);
+	out.texcoord.x = vertex.texcoord.x;
+}
+
+static Rect _transform_sse2(
+	const Mat4& mvp, const Vertex *src, const u16 *indices, Vertex *dst, u32 count
+) {
+	__m128 rows[3][4];
+	for (u32 r = 0; r < 3; r += 1) {
+		for (u32 c = 0; c < 4; c += 1) {
+			rows[r][c] = _mm_set1_ps(mvp.raw[c][r]);
+		}
+	}
+
+	__m128 lo_x = _mm_set1_ps(FLT_MAX);
+	__m128 lo_y = _mm_set1_ps(FLT_MAX);
+	__m128 hi_x = _mm_set1_ps(-FLT_MAX);
+	__m128 hi_y = _mm_set1_ps(-FLT_MAX);
+
+	u32 i = 0;
+	for (; i + 4 <= count; i += 4) {
+		Vertex *out = dst + i;
+		__m128 x = _load_sse2(src[indices ? indices[i + 0] : i + 0], out[0]);
+		__m128 y = _load_sse2(src[indices ? indices[i + 1] : i + 1], out[1]);
+		__m128 z = _load_sse2(src[indices ? indices[i + 2] : i + 2], out[2]);
+		__m128 w = _load_sse2(src[indices ? indices[i + 3] : i + 3], out[3]);
+		_MM_TRANSPOSE4_PS(x, y, z, w);
+
+		__m128 out_x = _dot_sse2(rows[0], x, y, z);
+		__m128 out_y = _dot_sse2(rows[1], x, y, z);
+		__m128 out_z = _dot_sse2(rows[2], x, y, z);
+
+		lo_x = _mm_min_ps(lo_x, out_x);
+		lo_y = _mm_min_ps(lo_y, out_y);
+		hi_x = _mm_max_ps(hi_x, out_x);
+		hi_y = _mm_max_ps(hi_y, out_y);
+
+		_MM_TRANSPOSE4_PS(out_x, out_y, out_z, w);
+		_mm_storeu_ps(out[0].position.raw, out_x);
+		_mm_storeu_ps(out[1].position.raw, out_y);
+		_mm_storeu_ps(out[2].position.raw, out_z);
+		_mm_storeu_ps(out[3].position.raw, w);
+	}
+
+	// Vertices left take one register each, x and y in the first two lanes
+	__m128 cols[4];
+	for (u32 c = 0; c < 4; c += 1) {
+		cols[c] = _mm_loadu_ps(mvp.raw[c]);
+	}
+
+	__m128 lo = _fold_min_sse2(lo_x, lo_y);
+	__m128 hi = _fold_max_sse2(hi_x, hi_y);
+	for (; i < count; i += 1) {
+		_transform_one_sse2(cols, src[indices ? indices[i] : i], dst[i], lo, hi);
+	}
+
+	return _to_region(lo, hi);
+}
+#endif
+
+#if VT_HAS_AVX2_KERNEL
+VT_TARGET_AVX2 static inline __m256 _dot_avx2(
+	const __m256 row[4], __m256 x, __m256 y, __m256 z
+) {
+	__m256 result = _mm256_fmadd_ps(row[2], z, row[3]);
+	result = _mm256_fmadd_ps(row[1], y, result);
+	return _mm256_fmadd_ps(row[0], x, result);
+}
+
+// Same as `_MM_TRANSPOSE4_PS`, within each 128 bits lane
+VT_TARGET_AVX2 static inline void _transpose_avx2(
+	__m256& row0, __m256& row1, __m256& row2, __m256& row3
+) {
+	__m256 t0 = _mm256_unpacklo_ps(row0, row1);
+	__m256 t1 = _mm256_unpackhi_ps(row0, row1);
+	__m256 t2 = _mm256_unpacklo_ps(row2, row3);
+	__m256 t3 = _mm256_unpackhi_ps(row2, row3);
+
+	row0 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(1, 0, 1, 0));
+	row1 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(3, 2, 3, 2));
+	row2 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(1, 0, 1, 0));
+	row3 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(3, 2, 3, 2));
+}
+
+VT_TARGET_AVX2 static inline __m256 _load_pair_avx2(
+	const Vertex& a, const Vertex& b, Vertex& out_a, Vertex& out_b
+) {
+	__m128 low = _load_sse2(a, out_a);
+	return _mm256_insertf128_ps(_mm256_castps128_ps256(low), _load_sse2(b, out_b), 1);
+}
+
+VT_TARGET_AVX2 static inline void _store_pair_avx2(__m256 pair, Vertex& a, Vertex& b) {
+	_mm_storeu_ps(a.position.raw, _mm256_castps256_ps128(pair));
+	_mm_storeu_ps(b.position.raw, _mm256_extractf128_ps(pair, 1));
+}
+
+VT_TARGET_AVX2 static Rect _transform_avx2(
+	const Mat4& mvp, const Vertex *src, const u16 *indices, Vertex *dst, u32 count
+) {
+	// Quads and other small draws never fill a register
+	if (count < 8) {
+		return _transform_sse2(mvp, src, indices, dst, count);
+	}
+
+	__m256 rows[3][4];
+	for (u32 r = 0; r < 3; r += 1) {
+		for (u32 c = 0; c < 4; c += 1) {
+			rows[r][c] = _mm256_set1_ps(mvp.raw[c][r]);
+		}
+	}
+
+	__m256 lo_x = _mm256_set1_ps(FLT_MAX);
+	__m256 lo_y = _mm256_set1_ps(FLT_MAX);
+	__m256 hi_x = _mm256_set1_ps(-FLT_MAX);
+	__m256 hi_y = _mm256_set1_ps(-FLT_MAX);
+
+	u32 i = 0;
+	for (; i + 8 <= count; i += 8) {
+		Vertex *out = dst + i;
+		const Vertex& v0 = src[indices ? indices[i + 0] : i + 0];
+		const Vertex& v1 = src[indices ? indices[i + 1] : i + 1];
+		const Vertex& v2 = src[indices ? indices[i + 2] : i + 2];
+		const Vertex& v3 = src[indices ? indices[i + 3] : i + 3];
+		const Vertex& v4 = src[indices ? indices[i + 4] : i + 4];
+		const Vertex& v5 = src[indices ? indices[i + 5] : i + 5];
+		const Vertex& v6 = src[indices ? indices[i + 6] : i + 6];
+		const Vertex& v7 = src[indices ? indices[i + 7] : i + 7];
+
+		// The low lanes hold the first four vertices, the high lanes the others
+		__m256 x = _load_pair_avx2(v0, v4, out[0], out[4]);
+		__m256 y = _load_pair_avx2(v1, v5, out[1], out[5]);
+		__m256 z = _load_pair_avx2(v2, v6, out[2], out[6]);
+		__m256 w = _load_pair_avx2(v3, v7, out[3], out[7]);
+		_transpose_avx2(x, y, z, w);
+
+		__m256 out_x = _dot_avx2(rows[0], x, y, z);
+		__m256 out_y = _dot_avx2(rows[1], x, y, z);
+		__m256 out_z = _dot_avx2(rows[2], x, y, z);
+
+		lo_x = _mm256_min_ps(lo_x, out_x);
+		lo_y = _mm256_min_ps(lo_y, out_y);
+		hi_x = _mm256_max_ps(hi_x, out_x);
+		hi_y = _mm256_max_ps(hi_y, out_y);
+
+		_transpose_avx2(out_x, out_y, out_z, w);
+		_store_pair_avx2(out_x, out[0], out[4]);
+		_store_pair_avx2(out_y, out[1], out[5]);
+		_store_pair_avx2(out_z, out[2], out[6]);
+		_store_pair_avx2(w, out[3], out[7]);
+	}
+
+	__m128 lo = _fold_min_sse2(
+		_mm_min_ps(_mm256_castps256_ps128(lo_x), _mm256_extractf128_ps(lo_x, 1)),
+		_mm_min_ps(_mm256_castps256_ps128(lo_y), _mm256_extractf128_ps(lo_y, 1))
+	);
+	__m128 hi = _fold_max_sse2(
+		_mm_max_ps(_mm256_castps256_ps128(hi_x), _mm256_extractf128_ps(hi_x, 1)),
+		_mm_max_ps(_mm256_castps256_ps128(hi_y), _mm256_extractf128_ps(hi_y, 1))
+	);
+	Rect region = _to_region(lo, hi);
+
+	// Up to seven vertices left
+	if (i < count) {
+		Rect tail = indices
+					  ? _transform_sse2(mvp, src, indices + i, dst + i, count - i)
+					  : _transform_sse2(mvp, src + i, nullptr, dst + i, count - i);
+
+		region.x1 = std::min(region.x1, tail.x1);
+		region.y1 = std::min(region.y1, tail.y1);
+		region.x2 = std::max(region.x2, tail.x2);
+		region.y2 = std::max(region.y2, tail.y2);
+	}
+
+	return region;
+}
+#endif
+
+static Isa _detect_isa() {
+#if VT_HAS_AVX2_KERNEL
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+		return Isa::AVX2;
+	}
+#endif
+#if VT_ARCH_X86_64
+	return Isa::SSE2; // Always available on x86-64
+#else
+	return Isa::Scalar;
+#endif
+}
+
+static Isa _supported_isa = _detect_isa();
+static Isa _cur_isa = _supported_isa;
+
+[[nodiscard]] Isa kernels::get_isa() {
+	return _cur_isa;
+}
+
+void kernels::set_isa(Isa isa) {
+	_cur_isa = std::min(isa, _supported_isa);
+}
+
+Rect kernels::transform_vertices(
+	const Mat4& mvp,
+	std::span<const Vertex> src,
+	const u16 *indices,
+	std::span<Vertex> dst
+) {
+	TransformFn transform = _transform_scalar;
+
+	switch (_cur_isa) {
+#if VT_HAS_AVX2_KERNEL
+	case Isa::AVX2: transform = _transform_avx2; break;
+#endif
+#if VT_ARCH_X86_64
+	case Isa::SSE2: transform = _transform_sse2; break;
+#endif
+	default: break;
+	}
+
+	return transform(mvp, src.data(), indices, dst.data(), dst.size());
+}
+
+Rect kernels::transform_vertices(
+	const Mat4& mvp,
+	std::span<const Vertex> src,
+	const u16 *indices,
+	std::span<CompactVertex> dst
+) {
+	Rect region { FLT_MAX, FLT_MAX, -FLT_MAX, -FLT_MAX };
+
+	// Only x and y are kept, so the depth row of `mvp` is skipped
+	const f32 (*m)[4] = mvp.raw;
+	for (u32 i = 0; i < dst.size(); i += 1) {
+		const Vertex& vertex = src[indices ? indices[i] : i];
+		const Vec3& pos = vertex.position;
+
+		f32 x = m[0][0] * pos.x + m[1][0] * pos.y + m[2][0] * pos.z + m[3][0];
+		f32 y = m[0][1] * pos.x + m[1][1] * pos.y + m[2][1] * pos.z + m[3][1];
+
+		dst[i] = CompactVertex { vertex };
+		dst[i].position = Vec2(x, y);
+
+		region.x1 = std::min(region.x1, x);
+		region.y1 = std::min(region.y1, y);
+		region.x2 = std::max(region.x2, x);
+		region.y2 = std::max(region.y2, y);
+	}
+
+	return region;
+}
+
+Rect kernels::transform_vertices(
+	const Mat4& mvp,
+	std::span<const Vertex> src,
+	const u16 *indices,
+	std::span<MultiTextureVertex> dst
+) {
+	Rect region { FLT_MAX, FLT_MAX, -FLT_MAX, -FLT_MAX };
+
+	for (u32 i = 0; i < dst.size(); i += 1) {
+		const Vertex& vertex = src[indices ? indices[i] : i];
+
+		Vec3 position = mvp * vertex.position;
+		dst[i].position = position;
+		dst[i].texcoord = vertex.texcoord;
+		dst[i].color = vertex.color;
+		dst[i].texture_slot = 0; // Set by the batcher unless a custom pipeline draws
+
+		region.x1 = std::min(region.x1, position.x);
+		region.y1 = std::min(region.y1, position.y);
+		region.x2 = std::max(region.x2, position.x);
+		region.y2 = std::max(region.y2, position.y);
+	}
+
+	return region;
+}
+
+Rect kernels::transform_rect(const Mat4& mvp, const Rect& rect) {
+	Vec3 corners[4] = {
+		mvp * Vec3(rect.x1, rect.y1, 0.0),
+		mvp * Vec3(rect.x2, rect.y1, 0.0),
+		mvp * Vec3(rect.x2, rect.y2, 0.0),
+		mvp * Vec3(rect.x1, rect.y2, 0.0),
+	};
+
+	Rect region { corners[0].x, corners[0].y, corners[0].x, corners[0].y };
+	for (const auto& corner : corners) {
+		region.x1 = std::min(region.x1, corner.x);
+		region.y1 = std::min(region.y1, corner.y);
+		region.x2 = std::max(region.x2, corner.x);
+		region.y2 = std::max(region.y2, corner.y);
+	}
+
+	return region;
+}
@@ -1,15 +1,30 @@
 #include "Engine.hpp"
 
+#include <cstring>
+
 int main(int argc, char *argv[]) {
-	VT_UNUSED(argc);
-	VT_UNUSED(argv);
+	// `--replay <path>` draws a frame capture instead of running the game
+	const char *replay_path = nullptr;
+	if (argc == 3 && std::strcmp(argv[1], "--replay") == 0) {
+		replay_path = argv[2];
+	}
+
+	// `--on-demand` only draws when something changed, for tools and menus
+	bool on_demand = argc == 2 && std::strcmp(argv[1], "--on-demand") == 0;
 
 	if (!vt::Engine::init()) {
 		return EXIT_FAILURE;
 	}
 
 	auto& engine = vt::Engine::get();
-	engine.run();
+	if (replay_path) {
+		engine.replay(replay_path);
+	} else {
+		if (on_demand) {
+			engine.set_redraw_mode(vt::RedrawMode::OnDemand);
+		}
+		engine.run();
+	}
 
 	return EXIT_SUCCESS;
 }
@@ -2,11 +2,17 @@
 
 #include "cglm/affine2d.h"
 
+#include <atomic>
+
 using namespace vt;
 
+// Drawables are also made on the threads recording into batch contexts
+static std::atomic<u32> s_revision {};
+
 Transform& Transform::translate(const Vec3& offset) {
 	m_position += offset;
 	m_update_transform = true;
+	_mark_changed();
 
 	return *this;
 }
@@ -14,6 +20,7 @@ Transform& Transform::translate(const Vec3& offset) {
 Transform& Transform::scale(const Vec2& factor) {
 	m_scale *= factor;
 	m_update_transform = true;
+	_mark_changed();
 
 	return *this;
 }
@@ -21,6 +28,7 @@ Transform& Transform::scale(const Vec2& factor) {
 Transform& Transform::rotate(f32 angle) {
 	m_rotation += angle;
 	m_update_transform = true;
+	_mark_changed();
 
 	return *this;
 }
@@ -28,21 +36,25 @@ Transform& Transform::rotate(f32 angle) {
 void Transform::set_origin(const Vec2& origin) {
 	m_origin = origin;
 	m_update_transform = true;
+	_mark_changed();
 }
 
 void Transform::set_position(const Vec3& position) {
 	m_position = position;
 	m_update_transform = true;
+	_mark_changed();
 }
 
 void Transform::set_rotation(f32 angle) {
 	m_rotation = angle;
 	m_update_transform = true;
+	_mark_changed();
 }
 
 void Transform::set_scale(const Vec2& scale) {
 	m_scale = scale;
 	m_update_transform = true;
+	_mark_changed();
 }
 
 [[nodiscard]] const vt::Vec2& Transform::get_origin() const {
@@ -67,7 +79,7 @@ void Transform::set_scale(const Vec2& scale) {
 	}
 
 	Vec2 position { m_position.x, m_position.y };
-	auto origin = -m_origin;
+	auto origin = m_origin;
 	auto scale = m_scale;
 
 	// Transformation: T * O * R * S * (-O) -> M
@@ -83,6 +95,25 @@ void Transform::set_scale(const Vec2& scale) {
 	m_transform = Mat4 {};
 	glm_mat4_ins3(m, m_transform.raw);
 
+	// Move the 2D translation out of the Z axis column
+	m_transform.raw[3][0] = m[2][0];
+	m_transform.raw[3][1] = m[2][1];
+	m_transform.raw[3][2] = m_position.z;
+	m_transform.raw[2][0] = 0.0;
+	m_transform.raw[2][1] = 0.0;
+
 	m_update_transform = false;
 	return m_transform;
 }
+
+[[nodiscard]] u32 Transform::get_revision() const {
+	return m_revision;
+}
+
+void Transform::_mark_changed() {
+	m_revision = _next_revision();
+}
+
+u32 Transform::_next_revision() {
+	return s_revision.fetch_add(1, std::memory_order_relaxed) + 1;
+}